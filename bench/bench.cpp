@@ -0,0 +1,362 @@
+//
+// Programmer:    Craig Stuart Sapp <craig@ccrma.stanford.edu>
+// Creation Date: Fri Oct 16 18:04:12 CEST 2026
+// Last Modified: Fri Oct 16 18:04:12 CEST 2026
+// Filename:      bench/bench.cpp
+// URL:           https://github.com/craigsapp/hum2ly/blob/master/bench/bench.cpp
+// Syntax:        C++11
+// vim:           ts=3 noexpandtab
+//
+// Description:   End-to-end benchmark of parsing and converting synthetic
+//                **kern scores.  Results are written as JSON so that runs
+//                from different commits can be compared.
+//
+
+#include "countingstream.h"
+#include "hum2ly.h"
+#include "inputbuffer.h"
+#include "scoregen.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <sstream>
+
+using namespace std;
+using namespace hum;
+
+//////////////////////////////
+//
+// Allocation counters for the whole program.
+//
+
+static atomic<long> AllocationCount(0);
+static atomic<long> AllocationBytes(0);
+
+void* operator new(size_t size) {
+	AllocationCount++;
+	AllocationBytes += size;
+	void* pointer = malloc(size ? size : 1);
+	if (!pointer) {
+		throw bad_alloc();
+	}
+	return pointer;
+}
+
+void* operator new[](size_t size) {
+	return operator new(size);
+}
+
+void operator delete(void* pointer) noexcept {
+	free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+	free(pointer);
+}
+
+
+
+//////////////////////////////
+//
+// BenchResult -- Measurements for one score.
+//
+
+class BenchResult {
+	public:
+		string name;
+		string engine;         // "spine" or "line" (--line-major)
+		ScoreParameters parameters;
+		long   inputbytes;
+		long   outputbytes;
+		double parsems;        // fastest parse time
+		double fullparsems;    // fastest parse time with rhythm analysis
+		double convertms;      // fastest conversion time
+		long   parseallocs;    // allocations during parse
+		long   parsealloc_bytes;
+		long   convertallocs;  // allocations during conversion
+		long   convertalloc_bytes;
+};
+
+// function declarations:
+void        defineOptions  (Options& options);
+vector<ScoreParameters> getDefaultSuite (void);
+BenchResult runBenchmark   (const ScoreParameters& parameters, int iterations,
+                            Options& options);
+void        printJson      (ostream& out, const string& label,
+                            vector<BenchResult>& results);
+void        printSummary   (ostream& out, BenchResult& result);
+double      getMilliseconds(chrono::steady_clock::time_point start,
+                            chrono::steady_clock::time_point end);
+
+
+int main(int argc, char** argv) {
+	Options options;
+	defineOptions(options);
+	options.process(argc, argv);
+
+	// With --compare-engines, each score is also converted with the
+	// line-major engine.
+	Options lineoptions;
+	defineOptions(lineoptions);
+	vector<char*> lineargs(argv, argv + argc);
+	char lineflag[] = "--line-major";
+	lineargs.push_back(lineflag);
+	lineoptions.process((int)lineargs.size(), lineargs.data());
+
+	vector<ScoreParameters> suite;
+	if (options.getInteger("parts") > 0) {
+		ScoreParameters parameters;
+		parameters.parts       = options.getInteger("parts");
+		parameters.measures    = options.getInteger("measures");
+		parameters.segments    = options.getInteger("segments");
+		parameters.keychanges  = options.getInteger("key-changes");
+		parameters.clefchanges = options.getInteger("clef-changes");
+		parameters.restdensity = options.getDouble("rests");
+		parameters.rhythms     = options.getInteger("rhythms");
+		parameters.seed        = options.getInteger("seed");
+		suite.push_back(parameters);
+	} else {
+		suite = getDefaultSuite();
+	}
+
+	int iterations = max(1, options.getInteger("iterations"));
+	vector<BenchResult> results;
+	for (int i=0; i<(int)suite.size(); i++) {
+		results.push_back(runBenchmark(suite[i], iterations, options));
+		printSummary(cerr, results.back());
+		if (options.getBoolean("compare-engines")) {
+			results.push_back(runBenchmark(suite[i], iterations, lineoptions));
+			printSummary(cerr, results.back());
+		}
+	}
+
+	if (options.getBoolean("output")) {
+		ofstream outfile(options.getString("output").c_str());
+		printJson(outfile, options.getString("label"), results);
+	} else {
+		printJson(cout, options.getString("label"), results);
+	}
+
+	return 0;
+}
+
+
+
+//////////////////////////////
+//
+// defineOptions -- The converter's options and the benchmark options.
+//
+
+void defineOptions(Options& options) {
+	options = HumdrumToLilypondConverter::getOptionDefinitions();
+	options.define("n|iterations=i:5", "number of runs for each score");
+	options.define("o|output=s", "JSON output file (default stdout)");
+	options.define("label=s", "label for the results, such as a commit id");
+	options.define("p|parts=i:0", "benchmark one score with this many parts");
+	options.define("m|measures=i:100", "measures in a single score");
+	options.define("s|segments=i:4", "labeled sections in a single score");
+	options.define("key-changes=i:2", "key changes in a single score");
+	options.define("clef-changes=i:1", "clef changes in a single score");
+	options.define("rests=d:0.05", "rest density in a single score");
+	options.define("rhythms=i:4", "rhythmic variety (1-8) in a single score");
+	options.define("seed=i:1", "random seed in a single score");
+	options.define("compare-engines=b", "also time each score with "
+			"--line-major");
+}
+
+
+
+//////////////////////////////
+//
+// getDefaultSuite -- Scores covering small chorales, wide orchestral
+//    scores, long sectioned single-part scores and many-segment scores.
+//
+
+vector<ScoreParameters> getDefaultSuite(void) {
+	vector<ScoreParameters> suite;
+	ScoreParameters parameters;
+
+	// chorale
+	parameters.parts = 4;   parameters.measures = 32;   parameters.segments = 2;
+	parameters.keychanges = 0; parameters.clefchanges = 0; parameters.rhythms = 3;
+	suite.push_back(parameters);
+
+	// wide scores
+	int widths[3] = { 4, 16, 64 };
+	for (int i=0; i<3; i++) {
+		parameters.parts = widths[i]; parameters.measures = 400;
+		parameters.segments = 8; parameters.keychanges = 4;
+		parameters.clefchanges = 2; parameters.rhythms = 6;
+		suite.push_back(parameters);
+	}
+
+	// long vocal part with many sections
+	parameters.parts = 1;   parameters.measures = 4000; parameters.segments = 100;
+	parameters.keychanges = 20; parameters.clefchanges = 0; parameters.rhythms = 8;
+	parameters.restdensity = 0.15;
+	suite.push_back(parameters);
+
+	// many parts with many segments
+	parameters.parts = 100; parameters.measures = 400;  parameters.segments = 200;
+	parameters.keychanges = 4; parameters.clefchanges = 1; parameters.rhythms = 4;
+	parameters.restdensity = 0.05;
+	suite.push_back(parameters);
+
+	return suite;
+}
+
+
+
+//////////////////////////////
+//
+// runBenchmark -- Generate a score and time its parsing and conversion.
+//    The same converter is used for each iteration, and the fastest times
+//    are kept.
+//
+
+BenchResult runBenchmark(const ScoreParameters& parameters, int iterations,
+		Options& options) {
+	BenchResult result;
+	result.name = parameters.getName();
+	result.engine = options.getBoolean("line-major") ? "line" : "spine";
+	result.parameters = parameters;
+
+	stringstream scorestream;
+	ScoreGenerator generator;
+	generator.generate(scorestream, parameters);
+	string score = scorestream.str();
+	result.inputbytes = (long)score.size();
+
+	HumdrumToLilypondConverter converter;
+	converter.setConfig(ConversionConfig::fromOptions(options));
+	bool fullparse = converter.getConfig().fullparse;
+	CountingStreambuf countbuf;
+	ostream nullout(&countbuf);
+	MemoryStreambuf inbuf;
+	istream instream(&inbuf);
+
+	for (int i=0; i<iterations; i++) {
+		HumdrumFile infile;
+		inbuf.setData(score.data(), score.size());
+		instream.clear();
+
+		long allocs = AllocationCount;
+		long bytes  = AllocationBytes;
+		auto starttime = chrono::steady_clock::now();
+		HumdrumToLilypondConverter::readInput(infile, instream, fullparse);
+		auto parsetime = chrono::steady_clock::now();
+		long parseallocs = AllocationCount - allocs;
+		long parsebytes  = AllocationBytes - bytes;
+
+		// humlib's full analysis, for comparison with the scan-only read:
+		{
+			HumdrumFile fullfile;
+			inbuf.setData(score.data(), score.size());
+			instream.clear();
+			auto fullstart = chrono::steady_clock::now();
+			fullfile.read(instream);
+			double fullms = getMilliseconds(fullstart,
+					chrono::steady_clock::now());
+			if ((i == 0) || (fullms < result.fullparsems)) {
+				result.fullparsems = fullms;
+			}
+		}
+
+		countbuf.reset();
+		allocs = AllocationCount;
+		bytes  = AllocationBytes;
+		auto convertstart = chrono::steady_clock::now();
+		converter.convert(nullout, infile);
+		nullout.flush();
+		auto endtime = chrono::steady_clock::now();
+
+		double parsems   = getMilliseconds(starttime, parsetime);
+		double convertms = getMilliseconds(convertstart, endtime);
+		if ((i == 0) || (parsems < result.parsems)) {
+			result.parsems = parsems;
+		}
+		if ((i == 0) || (convertms < result.convertms)) {
+			result.convertms = convertms;
+		}
+		// allocations are reported for the last (warm) iteration:
+		result.parseallocs        = parseallocs;
+		result.parsealloc_bytes   = parsebytes;
+		result.convertallocs      = AllocationCount - allocs;
+		result.convertalloc_bytes = AllocationBytes - bytes;
+		result.outputbytes        = countbuf.getCount();
+	}
+
+	return result;
+}
+
+
+
+//////////////////////////////
+//
+// printSummary -- One line of results for a score.
+//
+
+void printSummary(ostream& out, BenchResult& result) {
+	out << result.name << " (" << result.engine << "): parse "
+	    << result.parsems << " ms (full " << result.fullparsems
+	    << " ms), convert " << result.convertms << " ms, " << result.outputbytes
+	    << " bytes output, " << result.convertallocs
+	    << " allocations in conversion" << endl;
+}
+
+
+
+//////////////////////////////
+//
+// printJson --
+//
+
+void printJson(ostream& out, const string& label,
+		vector<BenchResult>& results) {
+	out << "{\n";
+	out << "\t\"label\": \"" << label << "\",\n";
+	out << "\t\"results\": [\n";
+	for (int i=0; i<(int)results.size(); i++) {
+		BenchResult& r = results[i];
+		ScoreParameters& p = r.parameters;
+		out << "\t\t{";
+		out << "\"name\": \"" << r.name << "\", ";
+		out << "\"engine\": \"" << r.engine << "\", ";
+		out << "\"parts\": " << p.parts << ", ";
+		out << "\"measures\": " << p.measures << ", ";
+		out << "\"segments\": " << p.segments << ", ";
+		out << "\"input_bytes\": " << r.inputbytes << ", ";
+		out << "\"output_bytes\": " << r.outputbytes << ", ";
+		out << "\"parse_ms\": " << r.parsems << ", ";
+		out << "\"full_parse_ms\": " << r.fullparsems << ", ";
+		out << "\"convert_ms\": " << r.convertms << ", ";
+		out << "\"output_mb_per_s\": " << (r.convertms > 0.0 ?
+				r.outputbytes / 1048576.0 / (r.convertms / 1000.0) : 0.0) << ", ";
+		out << "\"parse_allocs\": " << r.parseallocs << ", ";
+		out << "\"parse_alloc_bytes\": " << r.parsealloc_bytes << ", ";
+		out << "\"convert_allocs\": " << r.convertallocs << ", ";
+		out << "\"convert_alloc_bytes\": " << r.convertalloc_bytes;
+		out << "}" << (i < (int)results.size() - 1 ? "," : "") << "\n";
+	}
+	out << "\t]\n";
+	out << "}\n";
+}
+
+
+
+//////////////////////////////
+//
+// getMilliseconds --
+//
+
+double getMilliseconds(chrono::steady_clock::time_point start,
+		chrono::steady_clock::time_point end) {
+	return chrono::duration<double, milli>(end - start).count();
+}
+
+
+
@@ -0,0 +1,64 @@
+//
+// Programmer:    Craig Stuart Sapp <craig@ccrma.stanford.edu>
+// Creation Date: Fri Oct 16 19:21:45 CEST 2026
+// Last Modified: Fri Oct 16 19:21:45 CEST 2026
+// Filename:      bench/countingstream.h
+// URL:           https://github.com/craigsapp/hum2ly/blob/master/bench/countingstream.h
+// Syntax:        C++11
+// vim:           ts=3 noexpandtab
+//
+// Description:   Output stream buffer for benchmarks which counts and
+//                discards the characters written to it.
+//
+
+#ifndef _COUNTINGSTREAM_H
+#define _COUNTINGSTREAM_H
+
+#include <cstdio>
+#include <streambuf>
+
+namespace hum {
+
+using namespace std;
+
+
+//////////////////////////////
+//
+// CountingStreambuf -- Output stream buffer which counts and discards the
+//    characters written to it.
+//
+
+class CountingStreambuf : public streambuf {
+	public:
+		CountingStreambuf(void) { reset(); }
+		long getCount(void) { return m_count + (pptr() - pbase()); }
+		void reset(void) { m_count = 0; setp(m_buffer, m_buffer + sizeof(m_buffer)); }
+
+	protected:
+		int overflow(int ch) {
+			m_count += pptr() - pbase();
+			setp(m_buffer, m_buffer + sizeof(m_buffer));
+			if (ch != EOF) {
+				m_count++;
+			}
+			return ch == EOF ? 0 : ch;
+		}
+		int sync(void) {
+			m_count += pptr() - pbase();
+			setp(m_buffer, m_buffer + sizeof(m_buffer));
+			return 0;
+		}
+
+	private:
+		char m_buffer[1 << 16];
+		long m_count;
+};
+
+
+}  // end of namespace hum
+
+
+#endif /* _COUNTINGSTREAM_H */
+
+
+
@@ -0,0 +1,229 @@
+//
+// Programmer:    Craig Stuart Sapp <craig@ccrma.stanford.edu>
+// Creation Date: Sat Oct 17 17:12:36 CEST 2026
+// Last Modified: Sat Oct 17 17:12:36 CEST 2026
+// Filename:      bench/embedbench.c
+// URL:           https://github.com/craigsapp/hum2ly/blob/master/bench/embedbench.c
+// Syntax:        C99
+// vim:           ts=3 noexpandtab
+//
+// Description:   Compare converting files in-process with the libhum2ly C
+//                interface against running the hum2ly program for each
+//                file (with its output read from a pipe).  Results are
+//                printed as JSON.
+//
+// Usage:         hum2ly-embedbench [-n iterations] [-p hum2ly] [-l label]
+//                   file.krn ...
+//
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "hum2lyc.h"
+
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+extern char** environ;
+
+typedef struct {
+	char*  data;
+	size_t size;
+} FileData;
+
+// function declarations:
+double  getSeconds      (void);
+int     readFile        (const char* filename, FileData* file);
+long    convertInProcess(hum2ly_converter* converter, FileData* file);
+long    convertWithExec (const char* program, const char* filename);
+
+
+int main(int argc, char** argv) {
+	int iterations = 20;
+	const char* program = "./hum2ly";
+	const char* label = "";
+	int i;
+	int start = 1;
+	while ((start < argc - 1) && (argv[start][0] == '-')) {
+		if (strcmp(argv[start], "-n") == 0) {
+			iterations = atoi(argv[start+1]);
+		} else if (strcmp(argv[start], "-p") == 0) {
+			program = argv[start+1];
+		} else if (strcmp(argv[start], "-l") == 0) {
+			label = argv[start+1];
+		} else {
+			break;
+		}
+		start += 2;
+	}
+	int filecount = argc - start;
+	if ((filecount <= 0) || (iterations <= 0)) {
+		fprintf(stderr, "Usage: %s [-n iterations] [-p hum2ly] [-l label] "
+				"file.krn ...\n", argv[0]);
+		return 1;
+	}
+
+	FileData* files = calloc(filecount, sizeof(FileData));
+	for (i=0; i<filecount; i++) {
+		if (!readFile(argv[start+i], &files[i])) {
+			fprintf(stderr, "Error: cannot read %s\n", argv[start+i]);
+			return 1;
+		}
+	}
+
+	// in-process conversions with one warm converter:
+	hum2ly_converter* converter = hum2ly_create();
+	long inbytes = 0;
+	double starttime = getSeconds();
+	int n;
+	for (n=0; n<iterations; n++) {
+		for (i=0; i<filecount; i++) {
+			inbytes += convertInProcess(converter, &files[i]);
+		}
+	}
+	double inseconds = getSeconds() - starttime;
+	hum2ly_destroy(converter);
+
+	// one process for each conversion:
+	long execbytes = 0;
+	starttime = getSeconds();
+	for (n=0; n<iterations; n++) {
+		for (i=0; i<filecount; i++) {
+			long bytes = convertWithExec(program, argv[start+i]);
+			if (bytes < 0) {
+				fprintf(stderr, "Error: cannot run %s\n", program);
+				return 1;
+			}
+			execbytes += bytes;
+		}
+	}
+	double execseconds = getSeconds() - starttime;
+
+	long conversions = (long)iterations * filecount;
+	double inms   = inseconds * 1000.0 / conversions;
+	double execms = execseconds * 1000.0 / conversions;
+	fprintf(stderr, "in-process: %.3f ms/file, exec: %.3f ms/file\n",
+			inms, execms);
+	printf("{\n");
+	printf("\t\"label\": \"%s\",\n", label);
+	printf("\t\"version\": \"%s\",\n", hum2ly_get_version());
+	printf("\t\"files\": %d,\n", filecount);
+	printf("\t\"conversions\": %ld,\n", conversions);
+	printf("\t\"in_process_ms_per_file\": %.4f,\n", inms);
+	printf("\t\"exec_ms_per_file\": %.4f,\n", execms);
+	printf("\t\"in_process_output_bytes\": %ld,\n", inbytes);
+	printf("\t\"exec_output_bytes\": %ld\n", execbytes);
+	printf("}\n");
+
+	for (i=0; i<filecount; i++) {
+		free(files[i].data);
+	}
+	free(files);
+	return 0;
+}
+
+
+
+//////////////////////////////
+//
+// getSeconds -- Monotonic time in seconds.
+//
+
+double getSeconds(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec * 1.0e-9;
+}
+
+
+
+//////////////////////////////
+//
+// readFile -- Read a whole file into memory.
+//
+
+int readFile(const char* filename, FileData* file) {
+	FILE* input = fopen(filename, "rb");
+	if (!input) {
+		return 0;
+	}
+	size_t capacity = 65536;
+	file->data = malloc(capacity);
+	file->size = 0;
+	size_t count;
+	while ((count = fread(file->data + file->size, 1,
+			capacity - file->size, input)) > 0) {
+		file->size += count;
+		if (file->size == capacity) {
+			capacity *= 2;
+			file->data = realloc(file->data, capacity);
+		}
+	}
+	fclose(input);
+	return 1;
+}
+
+
+
+//////////////////////////////
+//
+// convertInProcess -- Returns the number of bytes of lilypond output.
+//
+
+long convertInProcess(hum2ly_converter* converter, FileData* file) {
+	const char* output;
+	size_t size;
+	hum2ly_convert(converter, file->data, file->size, &output, &size);
+	return (long)size;
+}
+
+
+
+//////////////////////////////
+//
+// convertWithExec -- Run the program on a file and read its output from
+//    a pipe.  Returns the number of bytes of output, or -1 if the program
+//    could not be run.
+//
+
+long convertWithExec(const char* program, const char* filename) {
+	int fds[2];
+	if (pipe(fds) != 0) {
+		return -1;
+	}
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init(&actions);
+	posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO);
+	posix_spawn_file_actions_addclose(&actions, fds[0]);
+	posix_spawn_file_actions_addclose(&actions, fds[1]);
+
+	char* args[3];
+	args[0] = (char*)program;
+	args[1] = (char*)filename;
+	args[2] = NULL;
+	pid_t pid;
+	int status = posix_spawn(&pid, program, &actions, NULL, args, environ);
+	posix_spawn_file_actions_destroy(&actions);
+	close(fds[1]);
+	if (status != 0) {
+		close(fds[0]);
+		return -1;
+	}
+
+	char buffer[65536];
+	long total = 0;
+	ssize_t count;
+	while ((count = read(fds[0], buffer, sizeof(buffer))) > 0) {
+		total += count;
+	}
+	close(fds[0]);
+	waitpid(pid, &status, 0);
+	return total;
+}
+
+
+
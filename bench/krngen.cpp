@@ -0,0 +1,53 @@
+//
+// Programmer:    Craig Stuart Sapp <craig@ccrma.stanford.edu>
+// Creation Date: Fri Oct 16 18:04:12 CEST 2026
+// Last Modified: Fri Oct 16 18:04:12 CEST 2026
+// Filename:      bench/krngen.cpp
+// URL:           https://github.com/craigsapp/hum2ly/blob/master/bench/krngen.cpp
+// Syntax:        C++11
+// vim:           ts=3 noexpandtab
+//
+// Description:   Command-line interface for generating synthetic **kern
+//                scores (for benchmarking hum2ly outside of the harness).
+//
+
+#ifndef _USE_HUMLIB_OPTIONS_
+#define _USE_HUMLIB_OPTIONS_
+#endif
+#include "humlib.h"
+#include "scoregen.h"
+
+#include <iostream>
+
+using namespace std;
+
+int main(int argc, char** argv) {
+	hum::Options options;
+	options.define("p|parts=i:4", "number of parts");
+	options.define("m|measures=i:32", "number of measures");
+	options.define("s|segments=i:2", "number of labeled sections");
+	options.define("key-changes=i:0", "number of key changes");
+	options.define("clef-changes=i:0", "number of clef changes");
+	options.define("rests=d:0.05", "fraction of notes which are rests");
+	options.define("rhythms=i:3", "number of different rhythms (1-8)");
+	options.define("seed=i:1", "random seed");
+	options.process(argc, argv);
+
+	hum::ScoreParameters parameters;
+	parameters.parts       = options.getInteger("parts");
+	parameters.measures    = options.getInteger("measures");
+	parameters.segments    = options.getInteger("segments");
+	parameters.keychanges  = options.getInteger("key-changes");
+	parameters.clefchanges = options.getInteger("clef-changes");
+	parameters.restdensity = options.getDouble("rests");
+	parameters.rhythms     = options.getInteger("rhythms");
+	parameters.seed        = options.getInteger("seed");
+
+	hum::ScoreGenerator generator;
+	generator.generate(cout, parameters);
+
+	return 0;
+}
+
+
+
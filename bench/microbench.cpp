@@ -0,0 +1,288 @@
+//
+// Programmer:    Craig Stuart Sapp <craig@ccrma.stanford.edu>
+// Creation Date: Fri Oct 16 19:21:45 CEST 2026
+// Last Modified: Fri Oct 16 19:21:45 CEST 2026
+// Filename:      bench/microbench.cpp
+// URL:           https://github.com/craigsapp/hum2ly/blob/master/bench/microbench.cpp
+// Syntax:        C++11
+// vim:           ts=3 noexpandtab
+//
+// Description:   Microbenchmarks for the per-token conversion functions.
+//                Tokens are taken from a generated score (or from the
+//                Humdrum files given as arguments), and each function is
+//                timed in ns/token with the parsing done beforehand.
+//
+
+#include "countingstream.h"
+#include "hum2ly.h"
+#include "scoregen.h"
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+using namespace hum;
+
+
+//////////////////////////////
+//
+// MicroBenchConverter -- Make the per-token functions of the converter
+//    callable from the benchmarks.
+//
+
+class MicroBenchConverter : public HumdrumToLilypondConverter {
+	public:
+		using HumdrumToLilypondConverter::convertNote;
+		using HumdrumToLilypondConverter::convertRest;
+		using HumdrumToLilypondConverter::convertDuration;
+		using HumdrumToLilypondConverter::convertKeySignature;
+		using HumdrumToLilypondConverter::convertClef;
+		using HumdrumToLilypondConverter::getKeyDesignation;
+		using HumdrumToLilypondConverter::arabicToRomanNumeral;
+};
+
+
+//////////////////////////////
+//
+// TokenSample -- Tokens of each type found in the input scores, in score
+//    order so that the distribution of values is realistic.
+//
+
+class TokenSample {
+	public:
+		vector<HTp>      notes;
+		vector<HTp>      rests;
+		vector<HTp>      clefs;
+		vector<HTp>      keysigs;
+		vector<KernNote> durations;  // decoded notes and rests
+		vector<HTp>      durationtokens;
+		vector<int>      numbers;    // measure numbers
+};
+
+class MicroResult {
+	public:
+		string name;
+		long   tokens;       // number of tokens in the sample
+		long   calls;        // total calls timed
+		double nspertoken;   // average time for each call
+};
+
+// function declarations:
+void   addTokens      (TokenSample& sample, HumdrumFile& infile);
+template <class Function>
+MicroResult timeFunction(const string& name, long count, double mintime,
+                        MicroBenchConverter& converter, Function function);
+void   printJson      (ostream& out, const string& label,
+                       vector<MicroResult>& results);
+
+
+int main(int argc, char** argv) {
+	Options options;
+	options.define("o|output=s", "JSON output file (default stdout)");
+	options.define("label=s", "label for the results, such as a commit id");
+	options.define("min-time=d:0.2", "minimum seconds to time each function");
+	options.define("p|parts=i:16", "parts in the generated score");
+	options.define("m|measures=i:400", "measures in the generated score");
+	options.define("seed=i:1", "random seed for the generated score");
+	options.process(argc, argv);
+
+	// The HumdrumFiles must stay alive while their tokens are used.
+	vector<HumdrumFile> infiles;
+	if (options.getArgCount() == 0) {
+		ScoreParameters parameters;
+		parameters.parts       = options.getInteger("parts");
+		parameters.measures    = options.getInteger("measures");
+		parameters.segments    = 8;
+		parameters.keychanges  = 8;
+		parameters.clefchanges = 4;
+		parameters.rhythms     = 6;
+		parameters.seed        = options.getInteger("seed");
+		stringstream score;
+		ScoreGenerator generator;
+		generator.generate(score, parameters);
+		infiles.resize(1);
+		infiles[0].read(score);
+	} else {
+		infiles.resize(options.getArgCount());
+		for (int i=0; i<options.getArgCount(); i++) {
+			infiles[i].read(options.getArg(i+1));
+		}
+	}
+
+	TokenSample sample;
+	for (int i=0; i<(int)infiles.size(); i++) {
+		addTokens(sample, infiles[i]);
+	}
+
+	MicroBenchConverter converter;
+	StateVariables states;
+	double mintime = options.getDouble("min-time");
+	vector<MicroResult> results;
+
+	results.push_back(timeFunction("convertNote", sample.notes.size(),
+			mintime, converter, [&](OutputBuffer& out, long i) {
+				converter.convertNote(out, sample.notes[i], states);
+			}));
+	results.push_back(timeFunction("convertRest", sample.rests.size(),
+			mintime, converter, [&](OutputBuffer& out, long i) {
+				converter.convertRest(out, sample.rests[i], states);
+			}));
+	results.push_back(timeFunction("convertDuration",
+			sample.durations.size(), mintime, converter,
+			[&](OutputBuffer& out, long i) {
+				converter.convertDuration(out, *sample.durationtokens[i],
+						sample.durations[i], states);
+			}));
+	results.push_back(timeFunction("convertKeySignature",
+			sample.keysigs.size(), mintime, converter,
+			[&](OutputBuffer& out, long i) {
+				converter.convertKeySignature(out, sample.keysigs[i]);
+			}));
+	results.push_back(timeFunction("convertClef", sample.clefs.size(),
+			mintime, converter, [&](OutputBuffer& out, long i) {
+				converter.convertClef(out, sample.clefs[i]);
+			}));
+	results.push_back(timeFunction("getKeyDesignation",
+			sample.keysigs.size(), mintime, converter,
+			[&](OutputBuffer& out, long i) {
+				if (converter.getKeyDesignation(sample.keysigs[i])) {
+					out << 'k';
+				}
+			}));
+	results.push_back(timeFunction("arabicToRomanNumeral",
+			sample.numbers.size(), mintime, converter,
+			[&](OutputBuffer& out, long i) {
+				out << converter.arabicToRomanNumeral(sample.numbers[i]);
+			}));
+
+	for (int i=0; i<(int)results.size(); i++) {
+		cerr << results[i].name << ": " << results[i].nspertoken
+		     << " ns/token (" << results[i].tokens << " tokens)" << endl;
+	}
+
+	if (options.getBoolean("output")) {
+		ofstream outfile(options.getString("output").c_str());
+		printJson(outfile, options.getString("label"), results);
+	} else {
+		printJson(cout, options.getString("label"), results);
+	}
+
+	return 0;
+}
+
+
+
+//////////////////////////////
+//
+// addTokens -- Collect the **kern tokens of interest from a file.
+//
+
+void addTokens(TokenSample& sample, HumdrumFile& infile) {
+	int measure = 0;
+	for (int i=0; i<infile.getLineCount(); i++) {
+		HumdrumLine& line = infile[i];
+		if (!line.hasSpines()) {
+			continue;
+		}
+		if (line.isBarline()) {
+			sample.numbers.push_back(++measure);
+			continue;
+		}
+		for (int j=0; j<line.getFieldCount(); j++) {
+			HTp token = line.token(j);
+			if (!token->isKern()) {
+				continue;
+			}
+			if (token->isClef()) {
+				sample.clefs.push_back(token);
+			} else if (token->isKeySignature()) {
+				sample.keysigs.push_back(token);
+			}
+			if (!token->isData() || token->isNull() || token->isChord()) {
+				continue;
+			}
+			if (token->isRest()) {
+				sample.rests.push_back(token);
+			} else {
+				sample.notes.push_back(token);
+			}
+			KernNote note;
+			note.decode(*token);
+			sample.durations.push_back(note);
+			sample.durationtokens.push_back(token);
+		}
+	}
+}
+
+
+
+//////////////////////////////
+//
+// timeFunction -- Call the function for every token of the sample,
+//    repeating the whole sample until at least mintime seconds have been
+//    spent.  The converter is cleared between passes (outside of the timed
+//    region) so that error messages do not accumulate.
+//
+
+template <class Function>
+MicroResult timeFunction(const string& name, long count, double mintime,
+		MicroBenchConverter& converter, Function function) {
+	MicroResult result;
+	result.name = name;
+	result.tokens = count;
+	result.calls = 0;
+	result.nspertoken = 0.0;
+	if (count <= 0) {
+		return result;
+	}
+
+	CountingStreambuf countbuf;
+	ostream stream(&countbuf);
+	OutputBuffer out(stream);
+	double seconds = 0.0;
+	while (seconds < mintime) {
+		converter.clear();
+		countbuf.reset();
+		auto starttime = chrono::steady_clock::now();
+		for (long i=0; i<count; i++) {
+			function(out, i);
+		}
+		out.flush();
+		auto endtime = chrono::steady_clock::now();
+		seconds += chrono::duration<double>(endtime - starttime).count();
+		result.calls += count;
+	}
+
+	result.nspertoken = seconds * 1.0e9 / result.calls;
+	return result;
+}
+
+
+
+//////////////////////////////
+//
+// printJson --
+//
+
+void printJson(ostream& out, const string& label,
+		vector<MicroResult>& results) {
+	out << "{\n";
+	out << "\t\"label\": \"" << label << "\",\n";
+	out << "\t\"results\": [\n";
+	for (int i=0; i<(int)results.size(); i++) {
+		MicroResult& r = results[i];
+		out << "\t\t{";
+		out << "\"name\": \"" << r.name << "\", ";
+		out << "\"tokens\": " << r.tokens << ", ";
+		out << "\"calls\": " << r.calls << ", ";
+		out << "\"ns_per_token\": " << r.nspertoken;
+		out << "}" << (i < (int)results.size() - 1 ? "," : "") << "\n";
+	}
+	out << "\t]\n";
+	out << "}\n";
+}
+
+
+
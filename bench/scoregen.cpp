@@ -0,0 +1,303 @@
+//
+// Programmer:    Craig Stuart Sapp <craig@ccrma.stanford.edu>
+// Creation Date: Fri Oct 16 18:04:12 CEST 2026
+// Last Modified: Fri Oct 16 18:04:12 CEST 2026
+// Filename:      bench/scoregen.cpp
+// URL:           https://github.com/craigsapp/hum2ly/blob/master/bench/scoregen.cpp
+// Syntax:        C++11
+// vim:           ts=3 noexpandtab
+//
+// Description:   Deterministic generator of synthetic **kern scores for
+//                benchmarking.
+//
+
+#include "scoregen.h"
+
+#include <sstream>
+#include <vector>
+
+using namespace std;
+
+namespace hum {
+
+// Rhythms in the order that they are added for more rhythmic variety,
+// and their durations in sixteenth notes:
+static const char* Rhythms[8]         = { "4", "8", "2", "16", "4.", "8.", "2.", "1" };
+static const int   RhythmDurations[8] = {  4,   2,   8,   1,    6,    3,    12,   16 };
+
+// Key signatures (seven flats to seven sharps) and their major keys:
+static const char* KeySharps = "f#c#g#d#a#e#b#";
+static const char* KeyFlats  = "b-e-a-d-g-c-f-";
+static const char* MajorKeys[15] = { "C-", "G-", "D-", "A-", "E-", "B-", "F",
+		"C", "G", "D", "A", "E", "B", "F#", "C#" };
+
+// Clefs used for clef changes:
+static const char* Clefs[5] = { "*clefG2", "*clefF4", "*clefC3", "*clefC4",
+		"*clefGv2" };
+
+static string getLabel      (int index);
+static string getKernPitch  (int diatonic);
+static string getKeySignature(int accids);
+
+
+
+//////////////////////////////
+//
+// ScoreParameters::ScoreParameters -- A four-part, chorale-sized score.
+//
+
+ScoreParameters::ScoreParameters(void) {
+	parts       = 4;
+	measures    = 32;
+	segments    = 2;
+	keychanges  = 0;
+	clefchanges = 0;
+	restdensity = 0.05;
+	rhythms     = 3;
+	seed        = 1;
+}
+
+
+
+//////////////////////////////
+//
+// ScoreParameters::getName -- Short description of the parameters.
+//
+
+string ScoreParameters::getName(void) const {
+	stringstream name;
+	name << "p" << parts << "-m" << measures << "-s" << segments
+	     << "-k" << keychanges << "-c" << clefchanges << "-r" << restdensity
+	     << "-y" << rhythms << "-x" << seed;
+	return name.str();
+}
+
+
+
+//////////////////////////////
+//
+// ScoreGenerator::generate --
+//
+
+void ScoreGenerator::generate(ostream& out, const ScoreParameters& parameters) {
+	int parts    = parameters.parts < 1 ? 1 : parameters.parts;
+	int measures = parameters.measures < 1 ? 1 : parameters.measures;
+	int rhythms  = parameters.rhythms;
+	if (rhythms < 1) {
+		rhythms = 1;
+	} else if (rhythms > 8) {
+		rhythms = 8;
+	}
+	int restlimit = (int)(parameters.restdensity * 1000);
+	m_state = parameters.seed ? parameters.seed : 1;
+
+	// The first spine is the lowest part: lower half in bass clef.
+	vector<int> pitch(parts);       // current diatonic pitch of each part
+	vector<int> low(parts);         // lowest diatonic pitch of each part
+	vector<int> clef(parts);        // current clef of each part
+	for (int i=0; i<parts; i++) {
+		bool bass = i < parts / 2;
+		low[i]   = bass ? 3 * 7 - 2 : 4 * 7;   // A2 or C4
+		pitch[i] = low[i] + 4;
+		clef[i]  = bass ? 1 : 0;
+	}
+
+	out << "!!!OTL: Synthetic score " << parameters.getName() << "\n";
+	int i;
+	for (i=0; i<parts; i++) {
+		out << (i ? "\t" : "") << "**kern";
+	}
+	out << "\n";
+	for (i=0; i<parts; i++) {
+		out << (i ? "\t" : "") << Clefs[clef[i]];
+	}
+	out << "\n";
+	for (i=0; i<parts; i++) {
+		out << (i ? "\t" : "") << "*k[]";
+	}
+	out << "\n";
+	for (i=0; i<parts; i++) {
+		out << (i ? "\t" : "") << "*C:";
+	}
+	out << "\n";
+	for (i=0; i<parts; i++) {
+		out << (i ? "\t" : "") << "*M4/4";
+	}
+	out << "\n";
+
+	int segment = 0;
+	int keychange = 0;
+	int clefchange = 0;
+	for (int m=0; m<measures; m++) {
+		if (m > 0) {
+			for (i=0; i<parts; i++) {
+				out << (i ? "\t" : "") << "=" << m + 1;
+			}
+			out << "\n";
+		}
+
+		// section labels, evenly spaced:
+		if ((segment < parameters.segments) &&
+				(m >= (long)segment * measures / parameters.segments)) {
+			string label = getLabel(segment);
+			for (i=0; i<parts; i++) {
+				out << (i ? "\t" : "") << "*>" << label;
+			}
+			out << "\n";
+			segment++;
+		}
+
+		// key changes, evenly spaced after the start:
+		if ((keychange < parameters.keychanges) &&
+				(m >= (long)(keychange + 1) * measures / (parameters.keychanges + 1))) {
+			int accids = random(15) - 7;
+			string signature = getKeySignature(accids);
+			for (i=0; i<parts; i++) {
+				out << (i ? "\t" : "") << signature;
+			}
+			out << "\n";
+			for (i=0; i<parts; i++) {
+				out << (i ? "\t" : "") << "*" << MajorKeys[accids + 7] << ":";
+			}
+			out << "\n";
+			keychange++;
+		}
+
+		// clef changes, evenly spaced after the start:
+		if ((clefchange < parameters.clefchanges) &&
+				(m >= (long)(clefchange + 1) * measures / (parameters.clefchanges + 1))) {
+			for (i=0; i<parts; i++) {
+				clef[i] = (clef[i] + 1 + random(4)) % 5;
+				out << (i ? "\t" : "") << Clefs[clef[i]];
+			}
+			out << "\n";
+			clefchange++;
+		}
+
+		// notes filling one 4/4 measure:
+		int remaining = 16;
+		while (remaining > 0) {
+			int r = random(rhythms);
+			if (RhythmDurations[r] > remaining) {
+				// use the longest rhythm which fits
+				r = -1;
+				for (int j=0; j<8; j++) {
+					if ((RhythmDurations[j] <= remaining) &&
+							((r < 0) || (RhythmDurations[j] > RhythmDurations[r]))) {
+						r = j;
+					}
+				}
+			}
+			remaining -= RhythmDurations[r];
+			for (i=0; i<parts; i++) {
+				out << (i ? "\t" : "") << Rhythms[r];
+				if (random(1000) < restlimit) {
+					out << "r";
+					continue;
+				}
+				pitch[i] += random(7) - 3;
+				if (pitch[i] < low[i]) {
+					pitch[i] = low[i] + (low[i] - pitch[i]);
+				} else if (pitch[i] > low[i] + 12) {
+					pitch[i] = low[i] + 12 - (pitch[i] - low[i] - 12);
+				}
+				out << getKernPitch(pitch[i]);
+				if (random(20) == 0) {
+					out << (random(2) ? "#" : "-");
+				}
+			}
+			out << "\n";
+		}
+	}
+
+	for (i=0; i<parts; i++) {
+		out << (i ? "\t" : "") << "==";
+	}
+	out << "\n";
+	for (i=0; i<parts; i++) {
+		out << (i ? "\t" : "") << "*-";
+	}
+	out << "\n";
+}
+
+
+
+//////////////////////////////
+//
+// ScoreGenerator::random -- Xorshift random numbers, so that scores are
+//    the same on all platforms.
+//
+
+unsigned ScoreGenerator::random(void) {
+	m_state ^= m_state << 13;
+	m_state ^= m_state >> 17;
+	m_state ^= m_state << 5;
+	return m_state;
+}
+
+
+int ScoreGenerator::random(int count) {
+	return (int)(random() % (unsigned)count);
+}
+
+
+
+//////////////////////////////
+//
+// getLabel -- Section label containing only letters (since labels are
+//    used in lilypond variable names): A, B, ..., Z, AA, AB, ...
+//
+
+static string getLabel(int index) {
+	string output;
+	index++;
+	while (index > 0) {
+		index--;
+		output.insert(output.begin(), (char)('A' + index % 26));
+		index /= 26;
+	}
+	return output;
+}
+
+
+
+//////////////////////////////
+//
+// getKernPitch -- Convert a diatonic pitch number (middle C = 28) into
+//    **kern pitch letters.
+//
+
+static string getKernPitch(int diatonic) {
+	int octave = diatonic / 7;
+	char letter = "cdefgab"[diatonic % 7];
+	if (octave >= 4) {
+		return string(octave - 3, letter);
+	}
+	return string(4 - octave, (char)(letter - 'a' + 'A'));
+}
+
+
+
+//////////////////////////////
+//
+// getKeySignature -- Key signature for a number of sharps (positive) or
+//    flats (negative).
+//
+
+static string getKeySignature(int accids) {
+	string output = "*k[";
+	if (accids > 0) {
+		output.append(KeySharps, 2 * accids);
+	} else if (accids < 0) {
+		output.append(KeyFlats, -2 * accids);
+	}
+	output += "]";
+	return output;
+}
+
+
+
+}  // end of namespace hum
+
+
+
@@ -0,0 +1,78 @@
+//
+// Programmer:    Craig Stuart Sapp <craig@ccrma.stanford.edu>
+// Creation Date: Fri Oct 16 18:04:12 CEST 2026
+// Last Modified: Fri Oct 16 18:04:12 CEST 2026
+// Filename:      bench/scoregen.h
+// URL:           https://github.com/craigsapp/hum2ly/blob/master/bench/scoregen.h
+// Syntax:        C++11
+// vim:           ts=3 noexpandtab
+//
+// Description:   Deterministic generator of synthetic **kern scores for
+//                benchmarking.
+//
+
+#ifndef _SCOREGEN_H
+#define _SCOREGEN_H
+
+#include <ostream>
+#include <string>
+
+namespace hum {
+
+using namespace std;
+
+
+//////////////////////////////
+//
+// ScoreParameters -- Shape of a generated score.
+//
+
+class ScoreParameters {
+	public:
+		ScoreParameters(void);
+
+		int      parts;       // number of **kern spines
+		int      measures;    // number of 4/4 measures
+		int      segments;    // number of *> labeled sections (0 = none)
+		int      keychanges;  // number of key signature changes
+		int      clefchanges; // number of clef changes in each part
+		double   restdensity; // fraction of notes which are rests
+		int      rhythms;     // number of different rhythms to use (1-8)
+		unsigned seed;        // random number seed
+
+		string   getName(void) const;
+};
+
+
+
+//////////////////////////////
+//
+// ScoreGenerator -- Write a synthetic score.  The same parameters always
+//    generate the same score (the generator does not use the platform's
+//    random number distributions).  All parts share the same rhythm on
+//    each line, so no null tokens are needed.
+//
+
+class ScoreGenerator {
+	public:
+		ScoreGenerator(void) { m_state = 1; }
+		~ScoreGenerator() {}
+
+		void     generate (ostream& out, const ScoreParameters& parameters);
+
+	protected:
+		unsigned random   (void);
+		int      random   (int count);
+
+	private:
+		unsigned m_state;  // xorshift random number state
+};
+
+
+}  // end of namespace hum
+
+
+#endif /* _SCOREGEN_H */
+
+
+
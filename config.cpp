@@ -0,0 +1,95 @@
+//
+// Programmer:    Craig Stuart Sapp <craig@ccrma.stanford.edu>
+// Creation Date: Sat Oct 17 18:21:47 CEST 2026
+// Last Modified: Sat Oct 17 18:21:47 CEST 2026
+// Filename:      config.cpp
+// URL:           https://github.com/craigsapp/hum2ly/blob/master/config.cpp
+// Syntax:        C++11
+// vim:           ts=3 noexpandtab
+//
+// Description:   Conversion settings, read once from the command-line
+//                options and shared by any number of converters.
+//
+
+#include "config.h"
+
+using namespace std;
+
+namespace hum {
+
+
+//////////////////////////////
+//
+// ConversionConfig::ConversionConfig -- The default settings (which must
+//    match the defaults in defineOptions()).
+//
+
+ConversionConfig::ConversionConfig(void) {
+	version   = "2.18.2";
+	kern      = false;
+	threads   = 1;
+	linemajor = false;
+	fullparse = false;
+	key       = "version=2.18.2\nkern=0";
+}
+
+
+
+//////////////////////////////
+//
+// ConversionConfig::defineOptions -- Add the conversion options to a
+//    program's options.
+//
+
+void ConversionConfig::defineOptions(Options& options) {
+	options.define("v|version=s:2.18.2", "lilypond version");
+	options.define("k|kern=b", "display corresponding **kern data as comments");
+	options.define("t|threads=i:1", "number of threads for converting parts "
+			"and segments in parallel (0 = all cores)");
+	options.define("line-major=b", "convert all parts in a single pass over "
+			"the lines of the file");
+	options.define("full-parse=b", "read input with humlib's full analysis "
+			"(including rhythms, which are not needed for the conversion)");
+}
+
+
+
+//////////////////////////////
+//
+// ConversionConfig::fromOptions -- Read the settings from processed
+//    options which include the definitions from defineOptions().
+//
+
+shared_ptr<const ConversionConfig> ConversionConfig::fromOptions(
+		Options& options) {
+	shared_ptr<ConversionConfig> config = make_shared<ConversionConfig>();
+	config->version   = options.getString("version");
+	config->kern      = options.getBoolean("kern");
+	config->threads   = options.getInteger("threads");
+	config->linemajor = options.getBoolean("line-major");
+	config->fullparse = options.getBoolean("full-parse");
+	config->key       = "version=" + config->version;
+	config->key      += config->kern ? "\nkern=1" : "\nkern=0";
+	return config;
+}
+
+
+
+//////////////////////////////
+//
+// ConversionConfig::getDefault -- The default settings, shared by all
+//    converters which have not been given options.
+//
+
+shared_ptr<const ConversionConfig> ConversionConfig::getDefault(void) {
+	static shared_ptr<const ConversionConfig> config =
+			make_shared<ConversionConfig>();
+	return config;
+}
+
+
+
+}  // end of namespace hum
+
+
+
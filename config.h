@@ -0,0 +1,62 @@
+//
+// Programmer:    Craig Stuart Sapp <craig@ccrma.stanford.edu>
+// Creation Date: Sat Oct 17 18:21:47 CEST 2026
+// Last Modified: Sat Oct 17 18:21:47 CEST 2026
+// Filename:      config.h
+// URL:           https://github.com/craigsapp/hum2ly/blob/master/config.h
+// Syntax:        C++11
+// vim:           ts=3 noexpandtab
+//
+// Description:   Conversion settings, read once from the command-line
+//                options and shared by any number of converters.
+//
+
+#ifndef _CONFIG_H
+#define _CONFIG_H
+
+#ifndef _USE_HUMLIB_OPTIONS_
+#define _USE_HUMLIB_OPTIONS_
+#endif
+#include "humlib.h"
+
+#include <memory>
+#include <string>
+
+namespace hum {
+
+using namespace std;
+
+
+//////////////////////////////
+//
+// ConversionConfig -- The settings of a conversion.  A config is not
+//    changed after it is made, so one config can be used by many
+//    converters in many threads at the same time (through a
+//    shared_ptr<const ConversionConfig>).
+//
+
+class ConversionConfig {
+	public:
+		ConversionConfig(void);
+		~ConversionConfig() {}
+
+		static void defineOptions(Options& options);
+		static shared_ptr<const ConversionConfig> fromOptions(Options& options);
+		static shared_ptr<const ConversionConfig> getDefault(void);
+
+		string version;    // lilypond version (empty = no \version line)
+		bool   kern;       // print **kern tokens as comments
+		int    threads;    // threads for parts and segments (0 = all cores)
+		bool   linemajor;  // convert all parts in one pass over the lines
+		bool   fullparse;  // read input with humlib's rhythm analysis
+		string key;        // the settings which change the output
+};
+
+
+}  // end of namespace hum
+
+
+#endif /* _CONFIG_H */
+
+
+
@@ -0,0 +1,81 @@
+//
+// Programmer:    Craig Stuart Sapp <craig@ccrma.stanford.edu>
+// Creation Date: Sat Oct 17 09:14:51 CEST 2026
+// Last Modified: Sat Oct 17 09:14:51 CEST 2026
+// Filename:      contenthash.h
+// URL:           https://github.com/craigsapp/hum2ly/blob/master/contenthash.h
+// Syntax:        C++11
+// vim:           ts=3 noexpandtab
+//
+// Description:   64-bit FNV-1a hash for identifying content in caches.
+//
+
+#ifndef _CONTENTHASH_H
+#define _CONTENTHASH_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+namespace hum {
+
+using namespace std;
+
+
+//////////////////////////////
+//
+// ContentHash -- Incremental FNV-1a hash.  Variable-length values are
+//    followed by a separator byte so that different sequences of strings
+//    (such as "ab" "c" and "a" "bc") give different hashes.
+//
+
+class ContentHash {
+	public:
+		ContentHash(void) { clear(); }
+
+		void clear(void) { m_hash = 14695981039346656037ULL; }
+
+		void add(const char* data, size_t size) {
+			for (size_t i=0; i<size; i++) {
+				m_hash ^= (unsigned char)data[i];
+				m_hash *= 1099511628211ULL;
+			}
+		}
+
+		void add(const string& text) {
+			add(text.data(), text.size());
+			add(char(0));
+		}
+
+		void add(char value) {
+			m_hash ^= (unsigned char)value;
+			m_hash *= 1099511628211ULL;
+		}
+
+		void add(int64_t value) {
+			for (int i=0; i<8; i++) {
+				add(char((value >> (i * 8)) & 0xff));
+			}
+		}
+
+		uint64_t getValue(void) const { return m_hash; }
+
+		string getHex(void) const {
+			char buffer[17];
+			snprintf(buffer, sizeof(buffer), "%016llx",
+					(unsigned long long)m_hash);
+			return buffer;
+		}
+
+	private:
+		uint64_t m_hash;
+};
+
+
+}  // end of namespace hum
+
+
+#endif /* _CONTENTHASH_H */
+
+
+
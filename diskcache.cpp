@@ -0,0 +1,391 @@
+//
+// Programmer:    Craig Stuart Sapp <craig@ccrma.stanford.edu>
+// Creation Date: Sat Oct 17 11:30:06 CEST 2026
+// Last Modified: Sat Oct 17 11:30:06 CEST 2026
+// Filename:      diskcache.cpp
+// URL:           https://github.com/craigsapp/hum2ly/blob/master/diskcache.cpp
+// Syntax:        C++11
+// vim:           ts=3 noexpandtab
+//
+// Description:   Content-addressed cache of conversion results in a
+//                directory, so that batch rebuilds only convert the files
+//                which have changed.
+//
+
+#include "diskcache.h"
+#include "contenthash.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iterator>
+#include <unordered_map>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <utime.h>
+
+using namespace std;
+
+namespace hum {
+
+
+//////////////////////////////
+//
+// DiskCache::DiskCache -- Constructor.  The cache directory should
+//    already exist.
+//
+
+DiskCache::DiskCache(const string& directory, long maxbytes) {
+	m_directory = directory;
+	m_maxbytes  = maxbytes;
+	m_size      = 0;
+	m_hits      = 0;
+	m_misses    = 0;
+	m_stores    = 0;
+	m_evictions = 0;
+	m_tempcount = 0;
+}
+
+
+
+//////////////////////////////
+//
+// DiskCache::getKey -- Hash the input data together with a description
+//    of everything else the output depends on (the converter version and
+//    options).
+//
+
+string DiskCache::getKey(const char* data, size_t size,
+		const string& configuration) {
+	ContentHash hash;
+	hash.add(data, size);
+	hash.add((int64_t)size);
+	hash.add(configuration);
+	return hash.getHex();
+}
+
+
+
+//////////////////////////////
+//
+// DiskCache::fetch -- Copy a cached conversion into a file, and return
+//    the statistics text which was stored with it.  Returns false on a
+//    cache miss.
+//
+
+bool DiskCache::fetch(const string& key, const string& filename,
+		string& statistics) {
+	string path = getEntryPath(key);
+	string statspath = getStatisticsPath(key);
+	if (!readFile(statspath, statistics) || !copyFile(path, filename)) {
+		m_misses++;
+		return false;
+	}
+	// mark as recently used for eviction:
+	utime(path.c_str(), NULL);
+	utime(statspath.c_str(), NULL);
+	m_hits++;
+	return true;
+}
+
+
+
+//////////////////////////////
+//
+// DiskCache::store -- Add a converted file and its statistics to the
+//    cache.  Each is written to a temporary file in the cache directory
+//    which is then renamed to the entry's name, which is atomic.  The
+//    statistics are stored first, so an entry's .ly file is not visible
+//    without them.  If two workers store the same entry, the contents
+//    are the same, so either one can win.
+//
+
+bool DiskCache::store(const string& key, const string& filename,
+		const string& statistics) {
+	string path = getEntryPath(key);
+	string subdir = path.substr(0, path.rfind('/'));
+	if ((mkdir(subdir.c_str(), 0777) != 0) && (errno != EEXIST)) {
+		return false;
+	}
+
+	string temp = getTempPath();
+	if (!writeFile(temp, statistics) ||
+			(rename(temp.c_str(), getStatisticsPath(key).c_str()) != 0)) {
+		unlink(temp.c_str());
+		return false;
+	}
+
+	temp = getTempPath();
+	if (!copyFile(filename, temp)) {
+		unlink(temp.c_str());
+		return false;
+	}
+	if (rename(temp.c_str(), path.c_str()) != 0) {
+		unlink(temp.c_str());
+		return false;
+	}
+	m_stores++;
+	return true;
+}
+
+
+
+//////////////////////////////
+//
+// DiskCache::evict -- Remove the least recently used entries until the
+//    cache is no larger than its size limit.  Returns the number of
+//    entries removed.  The .ly and .json files of a key are one entry:
+//    its size is the size of both files, and both are removed together.
+//    Files which cannot be used (an entry with only one of its files,
+//    or a temporary file left by an interrupted store) are removed once
+//    they are older than StaleSeconds, and counted in the size of the
+//    cache until then.  This scans the whole cache, so it should be
+//    called once after a batch of conversions (and not while other
+//    threads are storing entries).
+//
+
+// Age after which an incomplete entry or temporary file is removed:
+static const time_t StaleSeconds = 3600;
+
+int DiskCache::evict(void) {
+	class Entry {
+		public:
+			Entry(void) : size(0), time(0), files(0) {}
+			string path;   // entry path without the extension
+			long   size;   // size of the .ly and .json files
+			time_t time;   // latest modification time of the files
+			int    files;  // number of the two files which exist
+	};
+	vector<Entry> entries;
+	long total = 0;
+	time_t now = time(NULL);
+	struct stat info;
+
+	DIR* dir = opendir(m_directory.c_str());
+	if (dir == NULL) {
+		return 0;
+	}
+	struct dirent* subentry;
+	vector<string> subdirs;
+	while ((subentry = readdir(dir)) != NULL) {
+		string name = subentry->d_name;
+		if ((name.size() == 2) && isxdigit(name[0]) && isxdigit(name[1])) {
+			subdirs.push_back(m_directory + "/" + name);
+		} else if (name.compare(0, 4, "tmp-") == 0) {
+			string path = m_directory + "/" + name;
+			if (stat(path.c_str(), &info) != 0) {
+				continue;
+			}
+			if ((now - info.st_mtime > StaleSeconds) &&
+					(unlink(path.c_str()) == 0)) {
+				continue;
+			}
+			total += (long)info.st_size;
+		}
+	}
+	closedir(dir);
+
+	for (int i=0; i<(int)subdirs.size(); i++) {
+		dir = opendir(subdirs[i].c_str());
+		if (dir == NULL) {
+			continue;
+		}
+		unordered_map<string, int> index;  // entry for each key
+		while ((subentry = readdir(dir)) != NULL) {
+			string name = subentry->d_name;
+			if (name[0] == '.') {
+				continue;
+			}
+			size_t dot = name.rfind('.');
+			if (dot == string::npos) {
+				continue;
+			}
+			string extension = name.substr(dot);
+			if ((extension != ".ly") && (extension != ".json")) {
+				continue;
+			}
+			string path = subdirs[i] + "/" + name;
+			if ((stat(path.c_str(), &info) != 0) || !S_ISREG(info.st_mode)) {
+				continue;
+			}
+			string key = name.substr(0, dot);
+			auto it = index.find(key);
+			if (it == index.end()) {
+				it = index.emplace(key, (int)entries.size()).first;
+				entries.push_back(Entry());
+				entries.back().path = subdirs[i] + "/" + key;
+			}
+			Entry& entry = entries[it->second];
+			entry.size += (long)info.st_size;
+			entry.time = max(entry.time, info.st_mtime);
+			entry.files++;
+		}
+		closedir(dir);
+	}
+
+	int count = 0;
+	for (int i=0; i<(int)entries.size(); i++) {
+		if ((entries[i].files < 2) && (now - entries[i].time > StaleSeconds)) {
+			removeEntry(entries[i].path);
+			entries[i].size = 0;
+			count++;
+		}
+		total += entries[i].size;
+	}
+
+	if (total > m_maxbytes) {
+		sort(entries.begin(), entries.end(),
+			[](const Entry& a, const Entry& b) { return a.time < b.time; });
+		for (int i=0; (i<(int)entries.size()) && (total > m_maxbytes); i++) {
+			if ((entries[i].size > 0) && removeEntry(entries[i].path)) {
+				total -= entries[i].size;
+				count++;
+			}
+		}
+	}
+
+	m_size = total;
+	m_evictions += count;
+	return count;
+}
+
+
+
+//////////////////////////////
+//
+// DiskCache::removeEntry -- Remove the .ly and .json files of an entry
+//    (given as its path without an extension).  The .ly file is removed
+//    first, so the entry is never used without its statistics.  Returns
+//    false if neither file could be removed.
+//
+
+bool DiskCache::removeEntry(const string& path) {
+	bool removed = (unlink((path + ".ly").c_str()) == 0);
+	removed |= (unlink((path + ".json").c_str()) == 0);
+	return removed;
+}
+
+
+
+//////////////////////////////
+//
+// DiskCache::printStatistics -- One line with the hit and miss counts.
+//
+
+void DiskCache::printStatistics(ostream& out) {
+	long hits = m_hits;
+	long misses = m_misses;
+	long lookups = hits + misses;
+	out << "hum2ly cache: " << hits << " hits, " << misses << " misses";
+	if (lookups > 0) {
+		out << " (" << 100.0 * hits / lookups << "% hit rate)";
+	}
+	out << ", " << m_stores << " stored, " << m_evictions << " evicted, "
+	    << m_size / 1048576.0 << " MB in " << m_directory << endl;
+}
+
+
+
+//////////////////////////////
+//
+// DiskCache::getEntryPath --
+//
+
+string DiskCache::getEntryPath(const string& key) {
+	return m_directory + "/" + key.substr(0, 2) + "/" + key + ".ly";
+}
+
+
+
+//////////////////////////////
+//
+// DiskCache::getStatisticsPath --
+//
+
+string DiskCache::getStatisticsPath(const string& key) {
+	return m_directory + "/" + key.substr(0, 2) + "/" + key + ".json";
+}
+
+
+
+//////////////////////////////
+//
+// DiskCache::getTempPath -- A filename in the cache directory which no
+//    other thread or process is using.
+//
+
+string DiskCache::getTempPath(void) {
+	return m_directory + "/tmp-" + to_string(getpid()) + "-" +
+			to_string(m_tempcount++);
+}
+
+
+
+//////////////////////////////
+//
+// DiskCache::copyFile -- Returns false if the source cannot be read or
+//    the destination cannot be written.
+//
+
+bool DiskCache::copyFile(const string& source, const string& destination) {
+	ifstream infile(source.c_str(), ios::binary);
+	if (!infile.is_open()) {
+		return false;
+	}
+	ofstream outfile(destination.c_str(), ios::binary);
+	if (!outfile.is_open()) {
+		return false;
+	}
+	if (infile.peek() != EOF) {
+		outfile << infile.rdbuf();
+	}
+	outfile.close();
+	return !outfile.fail();
+}
+
+
+
+//////////////////////////////
+//
+// DiskCache::readFile -- Returns false if the file cannot be read.
+//
+
+bool DiskCache::readFile(const string& filename, string& text) {
+	ifstream infile(filename.c_str(), ios::binary);
+	if (!infile.is_open()) {
+		return false;
+	}
+	text.assign(istreambuf_iterator<char>(infile), istreambuf_iterator<char>());
+	return !infile.bad();
+}
+
+
+
+//////////////////////////////
+//
+// DiskCache::writeFile -- Returns false if the file cannot be written.
+//
+
+bool DiskCache::writeFile(const string& filename, const string& text) {
+	ofstream outfile(filename.c_str(), ios::binary);
+	if (!outfile.is_open()) {
+		return false;
+	}
+	outfile << text;
+	outfile.close();
+	return !outfile.fail();
+}
+
+
+
+}  // end of namespace hum
+
+
+
@@ -0,0 +1,87 @@
+//
+// Programmer:    Craig Stuart Sapp <craig@ccrma.stanford.edu>
+// Creation Date: Sat Oct 17 11:30:06 CEST 2026
+// Last Modified: Sat Oct 17 11:30:06 CEST 2026
+// Filename:      diskcache.h
+// URL:           https://github.com/craigsapp/hum2ly/blob/master/diskcache.h
+// Syntax:        C++11
+// vim:           ts=3 noexpandtab
+//
+// Description:   Content-addressed cache of conversion results in a
+//                directory, so that batch rebuilds only convert the files
+//                which have changed.
+//
+// Layout:        Each entry is stored in <directory>/<xx>/<key>.ly, where
+//                <key> is a 16-digit hexadecimal hash of the input data,
+//                converter version and options, and <xx> is the first two
+//                digits of the key.  The conversion statistics of the
+//                entry are stored next to it in <key>.json, and an entry
+//                is only used if both files exist.  Files are written to
+//                a temporary file and renamed into place, so readers
+//                (including other processes) never see a partial entry.
+//                The modification time of an entry is updated when it is
+//                used, and the least recently used entries (both files)
+//                are removed when the cache grows past its size limit.
+//
+
+#ifndef _DISKCACHE_H
+#define _DISKCACHE_H
+
+#include <atomic>
+#include <ostream>
+#include <string>
+
+namespace hum {
+
+using namespace std;
+
+
+//////////////////////////////
+//
+// DiskCache -- Conversion results stored in a directory.  All functions
+//    except evict() may be called from several threads at once.
+//
+
+class DiskCache {
+	public:
+		DiskCache(const string& directory, long maxbytes);
+		~DiskCache() {}
+
+		static string getKey    (const char* data, size_t size,
+		                         const string& configuration);
+		bool   fetch            (const string& key, const string& filename,
+		                         string& statistics);
+		bool   store            (const string& key, const string& filename,
+		                         const string& statistics);
+		int    evict            (void);
+		void   printStatistics  (ostream& out);
+
+	protected:
+		string getEntryPath     (const string& key);
+		string getStatisticsPath(const string& key);
+		string getTempPath      (void);
+		bool   removeEntry      (const string& path);
+		bool   copyFile         (const string& source,
+		                         const string& destination);
+		bool   readFile         (const string& filename, string& text);
+		bool   writeFile        (const string& filename, const string& text);
+
+	private:
+		string        m_directory;  // cache directory
+		long          m_maxbytes;   // size limit for all entries
+		long          m_size;       // size of entries after last eviction
+		atomic<long>  m_hits;       // entries used
+		atomic<long>  m_misses;     // entries not found
+		atomic<long>  m_stores;     // entries added
+		atomic<long>  m_evictions;  // entries removed by evict()
+		atomic<long>  m_tempcount;  // for unique temporary filenames
+};
+
+
+}  // end of namespace hum
+
+
+#endif /* _DISKCACHE_H */
+
+
+
@@ -11,6 +11,8 @@
 //
 
 #include "hum2ly.h"
+#include "contenthash.h"
+#include "spinecursor.h"
 
 #include <iostream>
 #include <math.h>
@@ -27,7 +29,8 @@ namespace hum {
 //
 
 void StateVariables::clear(void) {
-	duration = -1;
+	durnum = -1;
+	durden = 1;
 	dots = -1;
 	pitch = -99999;
 	chordpitches.clear();
@@ -37,16 +40,179 @@ void StateVariables::clear(void) {
 
 //////////////////////////////
 //
-// HumdrumToLilypondConverter::HumdrumToLilypondConverter -- Construtor.
+// StateVariables::hasDuration -- Returns true if the note has the same
+//    duration as the last note/chord/rest (so its duration does not need
+//    to be printed).
 //
 
-HumdrumToLilypondConverter::HumdrumToLilypondConverter(void) {
-	Options& options = m_options;
+bool StateVariables::hasDuration(const KernNote& note) const {
+	return (note.dots == dots) && (note.durnum == durnum) &&
+			(note.durden == durden);
+}
+
 
-	options.define("v|version=s:2.18.2", "lilypond version");
-	options.define("k|kern=b", "display corresponding **kern data");
 
+//////////////////////////////
+//
+// KernNote::decode -- Decode the first subtoken of a **kern note or rest
+//    in a single pass, without allocating memory.  The results match
+//    humlib's Convert::kernToBase40, kernToDiatonicPC,
+//    kernToAccidentalCount and recipToDurationNoDots functions.
+//
+
+void KernNote::decode(const string& token) {
+	// base-40 pitch class of each diatonic pitch (C to B) without the
+	// +2 offset for double flats:
+	static const int base40pc[7] = { 0, 6, 12, 17, 23, 29, 35 };
+	// diatonic pitch class of each letter (A to G):
+	static const int letterpc[7] = { 5, 6, 0, 1, 2, 3, 4 };
+
+	int upper   = 0;     // count of upper-case pitch letters
+	int lower   = 0;     // count of lower-case pitch letters
+	int number  = -1;    // first number in token (rhythm)
+	int number2 = -1;    // number after "%" in rhythm
+	int zeros   = 0;     // count of "0" (breve) rhythm symbols
+	bool rest   = false;
+	bool grace  = false;
+	int  len    = (int)token.size();
+
+	diatonic   = -1;
+	accidental = 0;
+	dots       = 0;
+	flags      = 0;
+	recipstart = 0;
+	reciplen   = 0;
+
+	for (int i=0; i<len; i++) {
+		char ch = token[i];
+		if (ch == ' ') {
+			// only decode the first note of a chord
+			break;
+		}
+		if ((ch >= 'a') && (ch <= 'g')) {
+			lower++;
+			if (diatonic < 0) {
+				diatonic = letterpc[ch - 'a'];
+			}
+		} else if ((ch >= 'A') && (ch <= 'G')) {
+			upper++;
+			if (diatonic < 0) {
+				diatonic = letterpc[ch - 'A'];
+			}
+		} else if ((ch >= '0') && (ch <= '9')) {
+			if (number >= 0) {
+				// digits after the rhythm have already been handled.
+				continue;
+			}
+			recipstart = i;
+			if ((ch == '0') && ((i+1 >= len) || (token[i+1] < '1') ||
+					(token[i+1] > '9'))) {
+				// 0 = breve, 00 = long, 000 = maxima
+				while ((i < len) && (token[i] == '0')) {
+					zeros++;
+					i++;
+				}
+				number = 0;
+				reciplen = i - recipstart;
+				i--;
+				continue;
+			}
+			number = 0;
+			while ((i < len) && (token[i] >= '0') && (token[i] <= '9')) {
+				number = number * 10 + (token[i] - '0');
+				i++;
+			}
+			if ((i < len - 1) && (token[i] == '%') && (token[i+1] >= '0') &&
+					(token[i+1] <= '9')) {
+				number2 = 0;
+				i++;
+				while ((i < len) && (token[i] >= '0') && (token[i] <= '9')) {
+					number2 = number2 * 10 + (token[i] - '0');
+					i++;
+				}
+			}
+			reciplen = i - recipstart;
+			i--;
+		} else {
+			switch (ch) {
+				case '.': dots++;                  break;
+				case '#': accidental++;            break;
+				case '-': accidental--;            break;
+				case 'r': rest = true;             break;
+				case 'q': grace = true;            break;
+				case '[': flags |= TieStart;       break;
+				case '_': flags |= TieContinue;    break;
+				case ']': flags |= TieEnd;         break;
+				case '(': flags |= SlurStart;      break;
+				case ')': flags |= SlurEnd;        break;
+				case ';': flags |= Fermata;        break;
+			}
+		}
+	}
+
+	// pitch:
+	int octave = -1000;
+	if (rest) {
+		flags |= Rest;
+	} else if ((upper > 0) && (lower == 0)) {
+		octave = 4 - upper;
+	} else if ((lower > 0) && (upper == 0)) {
+		octave = 3 + lower;
+	}
+	if ((octave <= -1000) || (diatonic < 0)) {
+		base40 = -1000;
+	} else {
+		base40 = base40pc[diatonic] + accidental + 2 + 40 * octave;
+	}
+
+	// duration without dots, in whole notes:
+	if (grace) {
+		flags |= Grace;
+		durnum = 0;
+		durden = 1;
+	} else if (number < 0) {
+		// no rhythm
+		durnum = 0;
+		durden = 1;
+	} else if (zeros > 0) {
+		durnum = 1 << zeros;
+		durden = 1;
+	} else if (number2 >= 0) {
+		durnum = number2;
+		durden = number;
+		// reduce to lowest terms so that equivalent rhythms compare equal
+		int a = durnum;
+		int b = durden;
+		while (b != 0) {
+			int t = a % b;
+			a = b;
+			b = t;
+		}
+		if (a > 1) {
+			durnum /= a;
+			durden /= a;
+		}
+	} else {
+		durnum = 1;
+		durden = number;
+	}
+}
+
+
+
+//////////////////////////////
+//
+// HumdrumToLilypondConverter::HumdrumToLilypondConverter -- Construtor.
+//
+
+HumdrumToLilypondConverter::HumdrumToLilypondConverter(void) {
+	m_config = ConversionConfig::getDefault();
 	m_indent = "  ";
+	m_infile = &m_ownedfile;
+	m_errorout = NULL;
+	m_profiler = NULL;
+	m_kernecho = false;
+	m_sourcemapout = NULL;
 }
 
 
@@ -56,38 +222,85 @@ HumdrumToLilypondConverter::HumdrumToLilypondConverter(void) {
 // HumdrumToLilypondConverter::convert -- Convert a Humdrum file into
 //    lilypond content.
 //
+//    When given a HumdrumFile, the converter borrows the caller's file
+//    instead of copying it.  The file is only read (never modified), and
+//    it is only referenced until convert() returns, so the caller must
+//    keep it alive (and not change it from another thread) for the
+//    duration of the call.  The istream and string versions parse into
+//    a file owned by the converter.
+//
 
 bool HumdrumToLilypondConverter::convert(ostream& out, HumdrumFile& infile) {
-	m_infile = infile;
-	return convert(out);
+	m_infile = &infile;
+	bool status = convertToStream(out);
+	m_infile = &m_ownedfile;
+	return status;
+}
+
+
+bool HumdrumToLilypondConverter::convert(OutputBuffer& out,
+		HumdrumFile& infile) {
+	m_infile = &infile;
+	bool status = convert(out);
+	m_infile = &m_ownedfile;
+	return status;
 }
 
 
 bool HumdrumToLilypondConverter::convert(ostream& out, istream& input) {
-	m_infile.read(input);
-	return convert(out);
+	{
+		HUM2LY_PROFILE_SCOPE(m_profiler, "parse");
+		readInput(m_ownedfile, input, m_config->fullparse);
+	}
+	m_infile = &m_ownedfile;
+	return convertToStream(out);
 }
 
 
 bool HumdrumToLilypondConverter::convert(ostream& out, const string& input) {
-	m_infile.read(input.c_str());
-	return convert(out);
+	{
+		HUM2LY_PROFILE_SCOPE(m_profiler, "parse");
+		readInput(m_ownedfile, input, m_config->fullparse);
+	}
+	m_infile = &m_ownedfile;
+	return convertToStream(out);
 }
 
 
-bool HumdrumToLilypondConverter::convert(ostream& out) {
-	HumdrumFile& infile = m_infile;
-   stringstream tempout;
-	bool status = true; // for keeping track of problems in conversion process.
+//////////////////////////////
+//
+// HumdrumToLilypondConverter::convertToStream -- All output is collected
+//    in an OutputBuffer which writes to the stream in large blocks (and
+//    after each segment, so that output is still streamed).  Returns false
+//    if the conversion failed or if the output could not be written.
+//
 
-	printHeaderComments(tempout);
+bool HumdrumToLilypondConverter::convertToStream(ostream& out) {
+	OutputBuffer output(out);
+	bool status = convert(output);
+	output.flush();
+	return status && !output.fail();
+}
 
-	string version = m_options.getString("version");
-	if (version != "") {
-		tempout << "\\version \"" << m_options.getString("version") << "\"\n\n";
-	}
 
-	printHeader(tempout);
+
+//////////////////////////////
+//
+// HumdrumToLilypondConverter::convert -- Convert the current input file
+//    into the output buffer.
+//
+
+bool HumdrumToLilypondConverter::convert(OutputBuffer& out) {
+	HUM2LY_PROFILE_SCOPE(m_profiler, "convert");
+	HumdrumFile& infile = *m_infile;
+	bool status = true; // for keeping track of problems in conversion process.
+
+	clear();
+	size_t startoffset = out.getOffset();
+	const ConversionConfig& config = *m_config;
+	m_kernecho = config.kern;
+	m_statistics.files = 1;
+	m_statistics.lines = infile.getLineCount();
 
 	// Create a list of the parts and which spine represents them.
 	vector<HTp>& kernstarts = m_kernstarts;
@@ -95,9 +308,11 @@ bool HumdrumToLilypondConverter::convert(ostream& out) {
 	if (kernstarts.size() == 0) {
 		// no parts in file, give up.  Perhaps return an error.
 		addErrorMessage("Error: no **kern spines to convert");
+		printErrorMessages(out);
 		status = false;
 		return status;
 	}
+	m_statistics.parts = (long)kernstarts.size();
 
 	// Reverse the order, since top part is last spine.
 	reverse(kernstarts.begin(), kernstarts.end());
@@ -108,48 +323,418 @@ bool HumdrumToLilypondConverter::convert(ostream& out) {
 		rkern[kernstarts[i]->getTrack()] = i;
 	}
 
+	// Output is streamed: segment variables are written to the output
+	// stream as soon as they are converted, and only the (small) staff
+	// and score assembly sections are buffered until the end.
+	printHeaderComments(out);
+
+	if (!config.version.empty()) {
+		out << "\\version \"" << config.version << "\"\n\n";
+	}
+
+	printHeader(out);
+
 	extractSegments();
+	indexStartTokens();
+	m_statistics.segments = getSegmentCount();
+	if (m_segmentcache) {
+		m_segmentcache->startConversion((int)kernstarts.size(),
+				getSegmentCount());
+	}
 
-	m_scoreout << "\\score {\n";
-	m_scoreout << m_indent << "<<\n";
+	m_scoreout += "\\score {\n";
+	m_scoreout += m_indent + "<<\n";
 
-	string partname;
-	for (int i=0; i<(int)kernstarts.size(); i++) {
-		partname = "part" + arabicToRomanNumeral(i+1);
-		m_staffout << partname << " = \\new Staff {\n" << m_indent;
-		m_scoreout << m_indent << "{ \\" << partname << " }\n";
-		status &= convertPart(tempout, partname, i);
-		m_staffout << "\n}\n\n";
-		if (!status) {
-			break;
+	if ((config.threads != 1) && (kernstarts.size() * getSegmentCount() > 1)) {
+		status &= convertSegmentsParallel(out, config.threads);
+	} else if (config.linemajor && !m_segmentcache) {
+		status &= convertLineMajor(out);
+	} else {
+		string partname;
+		for (int i=0; i<(int)kernstarts.size(); i++) {
+			partname = "part" + arabicToRomanNumeral(i+1);
+			m_staffout += partname + " = \\new Staff {\n" + m_indent;
+			m_scoreout += m_indent + "{ \\" + partname + " }\n";
+			status &= convertPart(out, partname, i);
+			m_staffout += "\n}\n\n";
+			if (!status) {
+				break;
+			}
 		}
 	}
 
-	m_scoreout << m_indent << ">>\n";
-	m_scoreout << "}\n";
+	m_scoreout += m_indent + ">>\n";
+	m_scoreout += "}\n";
 
-	tempout << m_staffout.str();
-	tempout << m_scoreout.str();
+	{
+		HUM2LY_PROFILE_SCOPE(m_profiler, "output");
+		out << m_staffout;
+		out << m_scoreout;
+		printFooterComments(out);
+	}
 
-	printFooterComments(tempout);
+	if (m_segmentcache) {
+		m_segmentcache->endConversion();
+	}
 
 	printErrorMessages(out);
-	out << tempout.str();
+
+	m_statistics.outputbytes = (long)(out.getOffset() - startoffset);
+
+	if (m_sourcemapout) {
+		printSourceMap(*m_sourcemapout, (long)startoffset);
+	}
+
+	return status;
+}
+
+
+
+//////////////////////////////
+//
+// HumdrumToLilypondConverter::convertSegmentsParallel -- Convert each
+//    segment of each part in a separate task.  Each worker thread has its
+//    own converter (and therefore its own StateVariables), and each
+//    segment is converted into its own buffer.  The buffers are written to
+//    the output in part/segment order as soon as each segment and all
+//    segments before it are finished, so the output is identical to
+//    converting the segments one after another.
+//
+
+bool HumdrumToLilypondConverter::convertSegmentsParallel(OutputBuffer& out,
+		int threads) {
+	class SegmentResult {
+		public:
+			OutputBuffer   out;     // lilypond variable for the segment
+			vector<string> errors;  // errors found in the segment
+			vector<SourceMapEntry> sourcemap; // offsets in out
+			bool           status;
+	};
+
+	int partcount    = (int)m_kernstarts.size();
+	int segmentcount = getSegmentCount();
+	int taskcount    = partcount * segmentcount;
+
+	// The pool and its worker converters are kept between conversions,
+	// so that converting many files does not start new threads or
+	// allocate new converters for each file.
+	if (!m_pool) {
+		m_pool.reset(new TaskPool(threads));
+	} else {
+		m_pool->setThreadCount(threads);
+	}
+	TaskPool& pool = *m_pool;
+	int workercount = min(pool.getThreadCount(), taskcount);
+	while ((int)m_workers.size() < workercount) {
+		m_workers.emplace_back(new HumdrumToLilypondConverter);
+	}
+	for (int i=0; i<workercount; i++) {
+		prepareWorker(*m_workers[i]);
+	}
+
+	vector<SegmentResult> results(taskcount);
+	bool status = true;
+
+	pool.run(taskcount,
+		[&](int task, int worker) {
+			HumdrumToLilypondConverter& converter = *m_workers[worker];
+			SegmentResult& result = results[task];
+			int part    = task / segmentcount;
+			int segment = task % segmentcount;
+			string partname = "part" + arabicToRomanNumeral(part+1);
+			converter.m_errors.clear();
+			converter.m_sourcemap.clear();
+			result.status = converter.convertSegmentVariable(result.out,
+					partname, part, segment);
+			result.errors.swap(converter.m_errors);
+			result.sourcemap.swap(converter.m_sourcemap);
+		},
+		[&](int task) {
+			if (!status) {
+				// a previous segment failed, so ignore the rest
+				return;
+			}
+			SegmentResult& result = results[task];
+			int part    = task / segmentcount;
+			int segment = task % segmentcount;
+			string partname = "part" + arabicToRomanNumeral(part+1);
+			if (segment == 0) {
+				m_staffout += partname + " = \\new Staff {\n" + m_indent;
+				m_scoreout += m_indent + "{ \\" + partname + " }\n";
+			}
+			if (m_labels.size() > 0) {
+				m_staffout += "\\" + getSegmentName(partname, segment) + " ";
+			}
+			addSourceMap(out, result.sourcemap);
+			out << result.out.getText();
+			out.flush();
+			m_errors.insert(m_errors.end(), result.errors.begin(),
+					result.errors.end());
+			status &= result.status;
+			if ((segment == segmentcount - 1) || !status) {
+				m_staffout += "\n}\n\n";
+			}
+			result.out.clear();
+		});
+
+	for (int i=0; i<workercount; i++) {
+		m_statistics.add(m_workers[i]->m_statistics);
+	}
+
+	return status;
+}
+
+
+
+//////////////////////////////
+//
+// HumdrumToLilypondConverter::convertLineMajor -- Convert all parts in a
+//    single pass over the lines of the file, instead of following the
+//    spine of each part through the whole file one part after another.
+//    Each token is sent to the emitter of its part, which has its own
+//    state variables, output buffer, errors, statistics and source map.
+//    Only the first token of each track on a line is converted, which is
+//    the token followed by the spine-by-spine conversion.  The buffers are
+//    written to the output in part order at the end, so the output is
+//    identical to the serial conversion (but the whole of each part is
+//    buffered).  The serial conversion stops at the first part which
+//    fails, so after a part fails, the later parts are not converted any
+//    further and their results are not used.
+//
+
+bool HumdrumToLilypondConverter::convertLineMajor(OutputBuffer& out) {
+	class PartEmitter {
+		public:
+			PartEmitter(void) : segments(0), status(true) {}
+			StateVariables states;
+			OutputBuffer   out;        // segment variables of the part
+			vector<string> errors;     // errors found in the part
+			ConversionStatistics statistics; // token counts for the part
+			vector<SourceMapEntry> sourcemap; // offsets in out
+			int            segments;   // number of segments started
+			bool           status;     // false after a token fails
+	};
+
+	HumdrumFile& infile = *m_infile;
+	vector<int>& rkern  = m_rkern;
+	int partcount       = (int)m_kernstarts.size();
+	int segmentcount    = getSegmentCount();
+	size_t errorcount   = m_errors.size();
+	size_t mapcount     = m_sourcemap.size();
+	vector<PartEmitter> emitters(partcount);
+	int failedpart      = partcount;  // first part which failed
+
+	// Move the errors and source map entries of the last converted token
+	// to the emitter of its part.
+	auto collect = [&](PartEmitter& emitter) {
+		if (m_errors.size() > errorcount) {
+			emitter.errors.insert(emitter.errors.end(),
+					m_errors.begin() + errorcount, m_errors.end());
+			m_errors.resize(errorcount);
+		}
+		if (m_sourcemap.size() > mapcount) {
+			emitter.sourcemap.insert(emitter.sourcemap.end(),
+					m_sourcemap.begin() + mapcount, m_sourcemap.end());
+			m_sourcemap.resize(mapcount);
+		}
+	};
+
+	string partname;
+	for (int s=0; s<segmentcount; s++) {
+		HUM2LY_PROFILE_SCOPE(m_profiler, "convertSegment", -1, s);
+		for (int p=0; p<partcount; p++) {
+			PartEmitter& emitter = emitters[p];
+			if (!emitter.status || (p > failedpart)) {
+				continue;
+			}
+			emitter.states.clear();
+			emitter.segments++;
+			partname = "part" + arabicToRomanNumeral(p+1);
+			emitter.out << getSegmentName(partname, s) << " =";
+			emitter.states.pitch = printRelativeStartingPitch(emitter.out, p, s);
+			emitter.out << " {\n";
+			if (getStartToken(p, s) == NULL) {
+				emitter.status = false;
+				failedpart = min(failedpart, p);
+			}
+		}
+
+		for (int i=m_segments[s]; i<m_segments[s+1]; i++) {
+			if (!infile[i].hasSpines()) {
+				continue;
+			}
+			int lasttrack = -1;
+			for (int j=0; j<infile[i].getFieldCount(); j++) {
+				HTp token = infile[i].token(j);
+				int track = token->getTrack();
+				if (track == lasttrack) {
+					// only dealing with single layer music for now
+					continue;
+				}
+				lasttrack = track;
+				if ((track < 0) || (track >= (int)rkern.size()) ||
+						(rkern[track] < 0)) {
+					continue;
+				}
+				int p = rkern[track];
+				PartEmitter& emitter = emitters[p];
+				if (!emitter.status || (p > failedpart)) {
+					continue;
+				}
+				if (SpineCursor::isSkipped(token)) {
+					continue;
+				}
+				swap(m_statistics, emitter.statistics);
+				emitter.status = convertSpineToken(emitter.out, token,
+						emitter.states);
+				swap(m_statistics, emitter.statistics);
+				collect(emitter);
+				if (!emitter.status) {
+					failedpart = min(failedpart, p);
+				}
+			}
+		}
+
+		for (int p=0; p<partcount; p++) {
+			if (emitters[p].status) {
+				emitters[p].out << "}\n\n";
+			}
+		}
+	}
+
+	bool status = true;
+	for (int p=0; p<partcount; p++) {
+		PartEmitter& emitter = emitters[p];
+		partname = "part" + arabicToRomanNumeral(p+1);
+		m_staffout += partname + " = \\new Staff {\n" + m_indent;
+		m_scoreout += m_indent + "{ \\" + partname + " }\n";
+		if (m_labels.size() > 0) {
+			for (int s=0; s<emitter.segments; s++) {
+				m_staffout += "\\" + getSegmentName(partname, s) + " ";
+			}
+		}
+		addSourceMap(out, emitter.sourcemap);
+		out << emitter.out.getText();
+		out.flush();
+		m_errors.insert(m_errors.end(), emitter.errors.begin(),
+				emitter.errors.end());
+		m_statistics.add(emitter.statistics);
+		m_staffout += "\n}\n\n";
+		if (!emitter.status) {
+			// the serial conversion stops after the first failed part
+			status = false;
+			break;
+		}
+	}
 
 	return status;
 }
 
 
 
+//////////////////////////////
+//
+// HumdrumToLilypondConverter::prepareWorker -- Give a worker converter
+//    everything it needs to convert parts of the current file.  The
+//    worker borrows the Humdrum file from this converter.
+//
+
+void HumdrumToLilypondConverter::prepareWorker(
+		HumdrumToLilypondConverter& worker) {
+	worker.m_infile     = m_infile;
+	worker.m_kernstarts = m_kernstarts;
+	worker.m_rkern      = m_rkern;
+	worker.m_segments   = m_segments;
+	worker.m_labels     = m_labels;
+	worker.m_starttokens = m_starttokens;
+	worker.m_indent     = m_indent;
+	worker.m_config     = m_config;
+	worker.m_profiler   = m_profiler;
+	worker.m_statistics.clear();
+	worker.m_segmentcache = m_segmentcache;
+	worker.m_kernecho   = m_kernecho;
+	worker.m_sourcemapout = m_sourcemapout;
+}
+
+
+
+//////////////////////////////
+//
+// HumdrumToLilypondConverter::clear -- Reset the data from a previous
+//    conversion.  This is done automatically at the start of each
+//    conversion so that a converter can be reused for many files.  The
+//    allocated memory of the buffers and lists is kept so that a warm
+//    converter does not need to reallocate them.  The duration cache is
+//    also kept, since it does not depend on the input file.
+//
+
+void HumdrumToLilypondConverter::clear(void) {
+	m_kernstarts.clear();
+	m_rkern.clear();
+	m_segments.clear();
+	m_labels.clear();
+	m_starttokens.clear();
+	m_staffout.clear();
+	m_scoreout.clear();
+	m_errors.clear();
+	m_states.clear();
+	m_statistics.clear();
+	m_sourcemap.clear();
+}
+
+
+
+//////////////////////////////
+//
+// HumdrumToLilypondConverter::setSegmentCache -- Keep the converted
+//    segment variables between conversions, so that reconverting an
+//    edited file only converts the segments which changed.  The cache
+//    holds the segments of the most recently converted file.
+//
+
+void HumdrumToLilypondConverter::setSegmentCache(bool state) {
+	if (!state) {
+		m_segmentcache.reset();
+	} else if (!m_segmentcache) {
+		m_segmentcache = make_shared<SegmentCache>();
+	}
+}
+
+
+
+//////////////////////////////
+//
+// HumdrumToLilypondConverter::getRecomputedSegments -- Return the (part,
+//    segment) index pairs which were converted (rather than taken from
+//    the segment cache) in the last conversion.  All segments are
+//    converted if the cache is not active.
+//
+
+vector<pair<int, int>> HumdrumToLilypondConverter::getRecomputedSegments(
+		void) {
+	vector<pair<int, int>> output;
+	if (m_segmentcache) {
+		return m_segmentcache->getRecomputedSegments();
+	}
+	for (int i=0; i<(int)m_kernstarts.size(); i++) {
+		for (int j=0; j<getSegmentCount(); j++) {
+			output.push_back(make_pair(i, j));
+		}
+	}
+	return output;
+}
+
+
+
 //////////////////////////////
 //
 // HumdrumToLilypondConverter::printHeader -- Print the lilypond \header.
 //
 
-void HumdrumToLilypondConverter::printHeader(ostream& tempout) {
-	tempout << "\\header {\n";
-	tempout << m_indent << "tagline = \"\"\n";
-	tempout << "}\n\n";
+void HumdrumToLilypondConverter::printHeader(OutputBuffer& out) {
+	out << "\\header {\n";
+	out << m_indent << "tagline = \"\"\n";
+	out << "}\n\n";
 }
 
 
@@ -160,7 +745,8 @@ void HumdrumToLilypondConverter::printHeader(ostream& tempout) {
 //
 
 void HumdrumToLilypondConverter::extractSegments(void) {
-	HumdrumFile& infile = m_infile;
+	HUM2LY_PROFILE_SCOPE(m_profiler, "extractSegments");
+	HumdrumFile& infile = *m_infile;
 	vector<int>& segments = m_segments;
 	vector<string>& labels = m_labels;
 	bool beforeDataQ = true;
@@ -201,8 +787,8 @@ void HumdrumToLilypondConverter::extractSegments(void) {
 //      records and global comments which occur before the first data line.
 //
 
-void HumdrumToLilypondConverter::printHeaderComments(ostream& out) {
-	HumdrumFile& infile = m_infile;
+void HumdrumToLilypondConverter::printHeaderComments(OutputBuffer& out) {
+	HumdrumFile& infile = *m_infile;
 	string token;
 	int count = 0;
 	bool starting;
@@ -238,10 +824,10 @@ void HumdrumToLilypondConverter::printHeaderComments(ostream& out) {
 //      records and global comments which occur after the last data line.
 //
 
-void HumdrumToLilypondConverter::printFooterComments(ostream& out) {
-	HumdrumFile& infile = m_infile;
+void HumdrumToLilypondConverter::printFooterComments(OutputBuffer& out) {
+	HumdrumFile& infile = *m_infile;
 
-	stringstream tout;
+	OutputBuffer tout;
 	int count = 0;
 	string token;
 	bool starting;
@@ -255,18 +841,18 @@ void HumdrumToLilypondConverter::printFooterComments(ostream& out) {
 		starting = true;
 		for (int j=0; j<(int)token.size(); j++) {
 			if (starting && (token[j] == '!')) {
-				tout << "%";
+				tout << '%';
 				continue;
 			}
 			starting = false;
 			tout << token[j];
 		}
-		tout << "\n";
+		tout << '\n';
 	}
 
 	if (count) {
-		out << "\n";
-		out << tout.str();
+		out << '\n';
+		out << tout.getText();
 	}
 }
 
@@ -278,55 +864,182 @@ void HumdrumToLilypondConverter::printFooterComments(ostream& out) {
 //    part into a lilypond part.
 //
 
-bool HumdrumToLilypondConverter::convertPart(ostream& out,
+bool HumdrumToLilypondConverter::convertPart(OutputBuffer& out,
 		const string& partname, int partindex) {
-	vector<int>& segments  = m_segments;
+	HUM2LY_PROFILE_SCOPE(m_profiler, "convertPart", partindex);
 	vector<string>& labels = m_labels;
-	HumdrumFile& infile    = m_infile;
-	StateVariables& states = m_states;
-
-	string segmentname;
 	bool status = true;
 
+	for (int i=0; i<getSegmentCount(); i++) {
+		if (labels.size() > 0) {
+			m_staffout += "\\" + getSegmentName(partname, i) + " ";
+		}
+		status &= convertSegmentVariable(out, partname, partindex, i);
+		if (!status) {
+			break;
+		}
+		out.flush();
+	}
+
+	return status;
+}
+
+
+
+//////////////////////////////
+//
+// HumdrumToLilypondConverter::convertSegmentVariable -- Convert one
+//    segment of a part into a lilypond variable.  If the segment cache is
+//    active and the segment has not changed since the last conversion,
+//    the cached variable (with its errors and statistics) is used instead
+//    of converting the segment again.
+//
+
+bool HumdrumToLilypondConverter::convertSegmentVariable(OutputBuffer& out,
+		const string& partname, int partindex, int segment) {
+	HUM2LY_PROFILE_SCOPE(m_profiler, "convertSegment", partindex, segment);
+	if (!m_segmentcache) {
+		return convertSegmentUncached(out, partname, partindex, segment);
+	}
+
+	SegmentCacheEntry entry;
+	string keytext;
+	uint64_t key = getSegmentKey(partname, partindex, segment, keytext);
+	HTp starttoken = getStartToken(partindex, segment);
+	int startline = starttoken ? starttoken->getLineIndex() : -1;
+
+	if (!m_segmentcache->lookup(key, keytext, startline, entry)) {
+		// Convert the segment on its own, collecting its output, errors
+		// and statistics for the cache.
+		ConversionStatistics statistics = m_statistics;
+		m_statistics.clear();
+		size_t errorcount = m_errors.size();
+		size_t mapcount = m_sourcemap.size();
+		OutputBuffer text;
+		entry.status = convertSegmentUncached(text, partname, partindex,
+				segment);
+		entry.text = text.getText();
+		entry.errors.assign(m_errors.begin() + errorcount, m_errors.end());
+		m_errors.resize(errorcount);
+		entry.sourcemap.assign(m_sourcemap.begin() + mapcount,
+				m_sourcemap.end());
+		m_sourcemap.resize(mapcount);
+		entry.statistics = m_statistics;
+		m_statistics = statistics;
+		entry.startline = startline;
+		entry.keytext.swap(keytext);
+		m_segmentcache->store(key, entry);
+		m_segmentcache->markRecomputed(partindex, segment);
+	}
+
+	addSourceMap(out, entry.sourcemap);
+	out << entry.text;
+	m_errors.insert(m_errors.end(), entry.errors.begin(), entry.errors.end());
+	m_statistics.add(entry.statistics);
+	return entry.status;
+}
+
+
+
+//////////////////////////////
+//
+// HumdrumToLilypondConverter::getSegmentKey -- Collect everything which
+//    the conversion of a segment depends on into keytext: its variable
+//    name, the options which change the output of a segment, and the text
+//    and field position of each of its tokens.  The state variables are
+//    reset at the start of each segment, so they do not depend on earlier
+//    segments.  Returns the hash of keytext.  The cache compares the whole
+//    keytext, so two segments with the same hash are never confused.
+//
+
+uint64_t HumdrumToLilypondConverter::getSegmentKey(const string& partname,
+		int partindex, int segment, string& keytext) {
+	keytext = getSegmentName(partname, segment);
+	keytext += '\n';
+	keytext += getOptionsKey();
+	keytext += '\n';
+	keytext += m_sourcemapout ? '1' : '0';
+	keytext += '\n';
+
+	for (SpineCursor cursor(getStartToken(partindex, segment),
+			m_segments[segment+1]); !cursor.atEnd(); cursor.next()) {
+		HTp token = cursor.getToken();
+		keytext += *token;
+		keytext += '\t';
+		keytext += to_string(token->getFieldIndex());
+		keytext += '\n';
+	}
+
+	ContentHash hash;
+	hash.add(keytext);
+	return hash.getValue();
+}
+
+
+
+//////////////////////////////
+//
+// HumdrumToLilypondConverter::convertSegmentUncached -- Convert one
+//    segment of a part into a lilypond variable.  The state variables are
+//    reset at the start of each segment (and the \relative starting pitch
+//    is given explicitly), so each segment can be converted independently
+//    of the others.
+//
+
+bool HumdrumToLilypondConverter::convertSegmentUncached(OutputBuffer& out,
+		const string& partname, int partindex, int segment) {
+	StateVariables& states = m_states;
+
 	states.clear();
 
-	if (labels.size() > 0) {
-		for (int i=0; i<(int)segments.size()-1; i++) {
-			segmentname = partname + "Z" + labels[i];
-			m_staffout << "\\" << segmentname << " ";
-			out << segmentname << " =";
-			states.pitch = printRelativeStartingPitch(out, partindex, segments[i],
-					segments[i+1]);
-			out << " {\n";
-			status &= convertSegment(out, partindex, segments[i], segments[i+1]);
-			if (!status) {
-				break;
-			}
-			out << "}\n\n";
-		}
-	} else {
-		segmentname = partname;
-		out << segmentname << " =";
-		states.pitch = printRelativeStartingPitch(out, partindex, 0,
-				infile.getLineCount());
-		out << "{\n";
-		status &= convertSegment(out, partindex, 0, infile.getLineCount());
+	out << getSegmentName(partname, segment) << " =";
+	states.pitch = printRelativeStartingPitch(out, partindex, segment);
+	out << " {\n";
+	bool status = convertSegment(out, partindex, segment, states);
+	if (status) {
 		out << "}\n\n";
 	}
-
 	return status;
 }
 
 
 
+//////////////////////////////
+//
+// HumdrumToLilypondConverter::getSegmentName -- Return the lilypond variable
+//    name for a segment of a part.  Segments are named after their
+//    section labels if there are any.
+//
+
+string HumdrumToLilypondConverter::getSegmentName(const string& partname,
+		int segment) {
+	if (m_labels.empty()) {
+		return partname;
+	}
+	return partname + "Z" + m_labels[segment];
+}
+
+
+
+//////////////////////////////
+//
+// HumdrumToLilypondConverter::getSegmentCount --
+//
+
+int HumdrumToLilypondConverter::getSegmentCount(void) {
+	return (int)m_segments.size() - 1;
+}
+
+
+
 ///////////////////////////////
 //
 // HumdrumToLilypondConverter::printRelativeStartingPitch --
 //
 
-int HumdrumToLilypondConverter::printRelativeStartingPitch(ostream& out,
-		int partindex, int startline, int endline) {
-	int pitch = getSegmentStartingPitch(partindex, startline, endline);
+int HumdrumToLilypondConverter::printRelativeStartingPitch(OutputBuffer& out,
+		int partindex, int segment) {
+	int pitch = getSegmentStartingPitch(partindex, segment);
 	if (pitch <= -1000) {
 		return pitch;
 	}
@@ -358,24 +1071,11 @@ int HumdrumToLilypondConverter::printRelativeStartingPitch(ostream& out,
 //
 
 int HumdrumToLilypondConverter::getSegmentStartingPitch(int partindex,
-		int startline, int endline) {
-
-	vector<HTp> starts = getStartTokens(partindex, startline, endline);
-	if (starts.size() == 0) {
-		return -99999;
-	}
-
-	HTp token = starts[0];
-
-	while ((token != NULL) && (token->getLineIndex() < endline)) {
-		if (!token->isData()) {
-			token = token->getNextToken();
-			continue;
-		} else if (token->isNull()) {
-			token = token->getNextToken();
-			continue;
-		} else if (token->isRest()) {
-			token = token->getNextToken();
+		int segment) {
+	for (SpineCursor cursor(getStartToken(partindex, segment),
+			m_segments[segment+1]); !cursor.atEnd(); cursor.next()) {
+		HTp token = cursor.getToken();
+		if (!token->isData() || token->isNull() || token->isRest()) {
 			continue;
 		}
 		return Convert::kernToBase40(*token);
@@ -387,29 +1087,56 @@ int HumdrumToLilypondConverter::getSegmentStartingPitch(int partindex,
 
 //////////////////////////////
 //
-// HumdrumToLilypondConverter::getStartTokens --
+// HumdrumToLilypondConverter::indexStartTokens -- Store the starting token
+//    of each part in each segment (the first token of the part's track on
+//    the first line with spines in the segment).  This is done in a single
+//    pass over the file after the segments are known, so that the start
+//    of a part/segment can be found without searching the file.
 //
 
-vector<HTp> HumdrumToLilypondConverter::getStartTokens(int partindex,
-		int startline, int endline) {
-	HumdrumFile& infile = m_infile;
-	vector<HTp>& kernstarts = m_kernstarts;
+void HumdrumToLilypondConverter::indexStartTokens(void) {
+	HumdrumFile& infile  = *m_infile;
+	vector<int>& rkern   = m_rkern;
+	int partcount        = (int)m_kernstarts.size();
+	int segmentcount     = getSegmentCount();
 
-	vector<HTp> output;
-	int targettrack = kernstarts[partindex]->getTrack();
-	for (int i=startline; i<endline; i++) {
-		if (!infile[i].hasSpines()) {
-			continue;
-		}
-		for (int j=0; j<infile[i].getFieldCount(); j++) {
-			if (infile[i].token(j)->getTrack() == targettrack) {
-				output.push_back(infile[i].token(j));
+	m_starttokens.assign(partcount * segmentcount, NULL);
+
+	for (int s=0; s<segmentcount; s++) {
+		HTp* starts = m_starttokens.data() + s * partcount;
+		for (int i=m_segments[s]; i<m_segments[s+1]; i++) {
+			if (!infile[i].hasSpines()) {
+				continue;
 			}
+			for (int j=0; j<infile[i].getFieldCount(); j++) {
+				HTp token = infile[i].token(j);
+				int track = token->getTrack();
+				if ((track < 0) || (track >= (int)rkern.size())) {
+					continue;
+				}
+				int part = rkern[track];
+				// only dealing with single layer music for now, so
+				// keep the first token of each track:
+				if ((part >= 0) && (starts[part] == NULL)) {
+					starts[part] = token;
+				}
+			}
+			break;
 		}
-		break;
 	}
+}
 
-	return output;
+
+
+//////////////////////////////
+//
+// HumdrumToLilypondConverter::getStartToken -- Return the first token of
+//    a part in a segment, or NULL if the part is not present at the start
+//    of the segment.
+//
+
+HTp HumdrumToLilypondConverter::getStartToken(int partindex, int segment) {
+	return m_starttokens[segment * m_kernstarts.size() + partindex];
 }
 
 
@@ -419,70 +1146,86 @@ vector<HTp> HumdrumToLilypondConverter::getStartTokens(int partindex,
 // HumdrumToLilypondConverter::convertSegment --
 //
 
-bool HumdrumToLilypondConverter::convertSegment(ostream& out, int partindex,
-		int startline, int endline) {
+bool HumdrumToLilypondConverter::convertSegment(OutputBuffer& out,
+		int partindex, int segment, StateVariables& states) {
 
-	vector<HTp> starttokens = getStartTokens(partindex, startline, endline);
+	HTp starttoken = getStartToken(partindex, segment);
 
-	if (starttokens.size() == 0) {
+	if (starttoken == NULL) {
 		// should not be missing a part (no parts that don't start
 		// at the beginning and end at the end.
 		return false;
 	}
 
-	// only dealing with single layer music for now:
-	return convertPartSegment(out, starttokens[0], endline);
+	return convertPartSegment(out, starttoken, m_segments[segment+1], states);
 }
 
 
 
 //////////////////////////////
 //
-// HumdrumToLilypondConverter::convertPartSegment --
+// HumdrumToLilypondConverter::convertPartSegment -- Convert the tokens
+//    of a part from the starting token until the line before endline.
+//    The spine is followed with a SpineCursor (not by recursion), so long
+//    segments do not need more stack space.
 //
 
-bool HumdrumToLilypondConverter::convertPartSegment(ostream& out,
-		HTp token, int endline) {
-
-	bool status = true;
-
+bool HumdrumToLilypondConverter::convertPartSegment(OutputBuffer& out,
+		HTp token, int endline, StateVariables& states) {
 	if (token == NULL) {
 		return false;
 	}
 
-	int line = token->getLineIndex();
-	if (line >= endline) {
-		return true;
+	for (SpineCursor cursor(token, endline); !cursor.atEnd();
+			cursor.next()) {
+		if (!convertSpineToken(out, cursor.getToken(), states)) {
+			return false;
+		}
 	}
+	return true;
+}
+
 
-	HTp nexttoken = token->getNextToken();
-	if (nexttoken && token->isExclusive()) {
-		return convertPartSegment(out, nexttoken, endline);
-	}
+
+//////////////////////////////
+//
+// HumdrumToLilypondConverter::convertSpineToken -- Convert one token of
+//    a part (other than its exclusive interpretation).  Returns false if
+//    the token could not be converted.
+//
+
+bool HumdrumToLilypondConverter::convertSpineToken(OutputBuffer& out,
+		HTp token, StateVariables& states) {
+	bool status = true;
 
 	if (token->isNull()) {
 		// do nothing for now, later check for dynamics, lyrics, etc.
+		if (token->isData()) {
+			m_statistics.nulls++;
+		}
 	} else if (token->isData()) {
-		status &= convertDataToken(out, token);
-		out << "\t\t% " << *token << endl;
+		addSourceMapEntry(out, token);
+		status &= convertDataToken(out, token, states);
+		endTokenLine(out, token);
 	} else if (token->isInterpretation()) {
-		convertInterpretationToken(out, token);
-		out << "\t\t% " << *token << endl;
-	} else if (token->isBarline()) {
-		out << "\t\t% " << *token << endl;
+		m_statistics.interpretations++;
+		if (token->isClef() || token->isKeySignature()) {
+			addSourceMapEntry(out, token);
+			convertInterpretationToken(out, token);
+			endTokenLine(out, token);
+		} else if (m_kernecho) {
+			endTokenLine(out, token);
+		}
 	} else {
-		out << "\t\t% " << *token << endl;
-	}
-
-	if (!status) {
-		return status;
+		if (token->isBarline()) {
+			m_statistics.barlines++;
+		}
+		if (m_kernecho) {
+			endTokenLine(out, token);
+		}
 	}
 
-	if (nexttoken) {
-		return convertPartSegment(out, nexttoken, endline);
-	} else {
-		return status;
-	}
+	return status;
 }
 
 
@@ -493,7 +1236,7 @@ bool HumdrumToLilypondConverter::convertPartSegment(ostream& out,
 // HumdrumToLilypondConverter::convertInterpretationToken --
 //
 
-bool HumdrumToLilypondConverter::convertInterpretationToken(ostream& out, 
+bool HumdrumToLilypondConverter::convertInterpretationToken(OutputBuffer& out, 
 		HTp token) {
 	bool status = true;
 	if (!token) {
@@ -515,91 +1258,77 @@ bool HumdrumToLilypondConverter::convertInterpretationToken(ostream& out,
 
 //////////////////////////////
 //
-// HumdrumToLilypondConverter::convertKeySignature -- A valid key signature 
+// Key signature tables:
+//
+// KeyTonics -- The tonic of each mode (rows, in the order of
+//    KeyModeNames) for key signatures with seven flats (column 0) through
+//    seven sharps (column 14).  The ionian and aeolian modes share the
+//    major and minor rows.
+//
+
+static constexpr const char* KeyModeNames[9] = { "major", "minor", "dorian",
+		"phrygian", "lydian", "mixolydian", "locrian", "ionian", "aeolian" };
+
+static constexpr int KeyModeRows[9] = { 0, 1, 2, 3, 4, 5, 6, 0, 1 };
+
+static constexpr const char* KeyTonics[7][15] = {
+	// major/ionian:
+	{ "ces", "ges", "des", "aes", "ees", "bes", "f", "c",
+	  "g", "d", "a", "e", "b", "fis", "cis" },
+	// minor/aeolian:
+	{ "aes", "ees", "bes", "f", "c", "g", "d", "a",
+	  "e", "b", "fis", "cis", "gis", "dis", "ais" },
+	// dorian:
+	{ "des", "aes", "ees", "bes", "f", "c", "g", "d",
+	  "a", "e", "b", "fis", "cis", "gis", "dis" },
+	// phrygian:
+	{ "ees", "bes", "f", "c", "g", "d", "a", "e",
+	  "b", "fis", "cis", "gis", "dis", "ais", "eis" },
+	// lydian:
+	{ "fes", "ces", "ges", "des", "aes", "ees", "bes", "f",
+	  "c", "g", "d", "a", "e", "b", "fis" },
+	// mixolydian:
+	{ "ges", "des", "aes", "ees", "bes", "f", "c", "g",
+	  "d", "a", "e", "b", "fis", "cis", "gis" },
+	// locrian:
+	{ "bes", "f", "c", "g", "d", "a", "e", "b",
+	  "fis", "cis", "gis", "dis", "ais", "eis", "bis" }
+};
+
+// Bit position of each pitch letter (a-g) in a key signature bitmask.
+// Sharps use bits 0-6 in the order F C G D A E B, and flats use bits
+// 7-13 in the order B E A D G C F, so standard key signatures are
+// contiguous runs of bits.
+static constexpr int KeySharpBits[7] = { 4, 6, 1, 3, 5, 0, 2 };
+static constexpr int KeyFlatBits[7]  = { 9, 7, 12, 10, 8, 13, 11 };
+
+
+
+//////////////////////////////
+//
+// HumdrumToLilypondConverter::convertKeySignature -- A valid key signature
 //   is presumed to be the input.
 //
 
-bool HumdrumToLilypondConverter::convertKeySignature(ostream& out, HTp token) {
+bool HumdrumToLilypondConverter::convertKeySignature(OutputBuffer& out,
+		HTp token) {
 	bool status = true;
 
-	bool fs = token->find("f#") != string::npos;
-	bool cs = token->find("c#") != string::npos;
-	bool gs = token->find("g#") != string::npos;
-	bool ds = token->find("d#") != string::npos;
-	bool as = token->find("a#") != string::npos;
-	bool es = token->find("e#") != string::npos;
-	bool bs = token->find("b#") != string::npos;
-
-	bool bb = token->find("b-") != string::npos;
-	bool eb = token->find("e-") != string::npos;
-	bool ab = token->find("a-") != string::npos;
-	bool db = token->find("d-") != string::npos;
-	bool gb = token->find("g-") != string::npos;
-	bool cb = token->find("c-") != string::npos;
-	bool fb = token->find("f-") != string::npos;
-
-	int accids = 0;
-	if (fs && !cs && !gs && !ds && !as && !es && !bs) {
-		accids = 1;
-	} else if (fs && cs && !gs && !ds && !as && !es && !bs) {
-		accids = 2;
-	} else if (fs && cs && gs && !ds && !as && !es && !bs) {
-		accids = 3;
-	} else if (fs && cs && gs && ds && !as && !es && !bs) {
-		accids = 4;
-	} else if (fs && cs && gs && ds && as && !es && !bs) {
-		accids = 5;
-	} else if (fs && cs && gs && ds && as && es && !bs) {
-		accids = 6;
-	} else if (fs && cs && gs && ds && as && es && bs) {
-		accids = 7;
-	} else if (bb && !eb && !ab && !db && !gb && !cb && !fb) {
-		accids = -1;
-	} else if (bb && eb && !ab && !db && !gb && !cb && !fb) {
-		accids = -2;
-	} else if (bb && eb && ab && !db && !gb && !cb && !fb) {
-		accids = -3;
-	} else if (bb && eb && ab && db && !gb && !cb && !fb) {
-		accids = -4;
-	} else if (bb && eb && ab && db && gb && !cb && !fb) {
-		accids = -5;
-	} else if (bb && eb && ab && db && gb && cb && !fb) {
-		accids = -6;
-	} else if (bb && eb && ab && db && gb && cb && fb) {
-		accids = -7;
-	} else if (!bb && !eb && !ab && !db && !gb && !cb && !fb 
-			&& !fs && !cs && !gs && !ds && !as && !es && !bs) {
-		accids = 0;
-	} else {
+	int accids = getKeySignatureAccidentals(*token);
+	if ((accids < -7) || (accids > 7)) {
 		// non-standard key signature
+		m_statistics.unknownkeys++;
 		addErrorMessage("Error: non-standard key signature: " + *token, token);
 		return true;
 	}
 
-	string mode = "major";
+	int mode = 0;  // presume major key if no key designation
 	HTp designation = getKeyDesignation(token);
-	string tonic = "";
-	char letter;
+	string tonic;
 	if (designation == NULL) {
-		// presume major key if no key designation
-		switch (accids) {
-			case  0: tonic = "c"; break;
-			case  1: tonic = "g"; break;
-			case  2: tonic = "d"; break;
-			case  3: tonic = "a"; break;
-			case  4: tonic = "e"; break;
-			case  5: tonic = "b"; break;
-			case  6: tonic = "fis"; break;
-			case  7: tonic = "cis"; break;
-			case -1: tonic = "f"; break;
-			case -2: tonic = "bes"; break;
-			case -3: tonic = "ees"; break;
-			case -4: tonic = "aes"; break;
-			case -5: tonic = "des"; break;
-			case -6: tonic = "ges"; break;
-			case -7: tonic = "ces"; break;
-		}
+		tonic = KeyTonics[0][accids + 7];
 	} else {
+		char letter;
 		for (int i=1; i<(int)designation->size(); i++) {
 			letter = (*designation)[i];
 			if (letter == ':') {
@@ -613,289 +1342,123 @@ bool HumdrumToLilypondConverter::convertKeySignature(ostream& out, HTp token) {
 				tonic += tolower(letter);
 			}
 		}
-		
-		if (islower((*designation)[2])) {
-			mode = "minor";
-		}
-		if (designation->find("dor")) {
-			mode = "dorian";
-		} else if (designation->find("phr")) {
-			mode = "phrygian";
-		} else if (designation->find("lyd")) {
-			mode = "lydian";
-		} else if (designation->find("mix")) {
-			mode = "mixolydian";
-		} else if (designation->find("aeo")) {
-			mode = "aeolian";
-		} else if (designation->find("loc")) {
-			mode = "locrian";
-		} else if (designation->find("ion")) {
-			mode = "ionian";
-		}
+		mode = getKeyMode(*designation);
 	}
 
-
-	if ((mode == "major") || (mode == "ionian")) {
-		if ((accids == 0) && (tonic == "c")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == 1) && (tonic == "g")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == 2) && (tonic == "d")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == 3) && (tonic == "a")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == 4) && (tonic == "e")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == 5) && (tonic == "b")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == 6) && (tonic == "fis")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == 7) && (tonic == "cis")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == -1) && (tonic == "f")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == -2) && (tonic == "bes")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == -3) && (tonic == "ees")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == -4) && (tonic == "aes")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == -5) && (tonic == "des")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == -6) && (tonic == "ges")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == -7) && (tonic == "ces")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		}
+	if (tonic == KeyTonics[KeyModeRows[mode]][accids + 7]) {
+		out << "\\key " << tonic << " \\" << KeyModeNames[mode];
+		return status;
 	}
 
-	if ((mode == "minor") || (mode == "aeolian")) {
-		if ((accids == 0) && (tonic == "a")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == 1) && (tonic == "e")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == 2) && (tonic == "b")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == 3) && (tonic == "fis")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == 4) && (tonic == "cis")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == 5) && (tonic == "gis")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == 6) && (tonic == "dis")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == 7) && (tonic == "ais")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == -1) && (tonic == "d")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == -2) && (tonic == "g")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == -3) && (tonic == "c")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == -4) && (tonic == "f")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == -5) && (tonic == "bes")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == -6) && (tonic == "ees")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == -7) && (tonic == "aes")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		}
+	m_statistics.unknownkeys++;
+	string error = "Error: Unknown key signatue " + (*token);
+	if (designation) {
+		error += " in combination with the key " + (*designation);
 	}
+	addErrorMessage(error, token);
 
-	if (mode == "dorian") {
-		if ((accids == 0) && (tonic == "d")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == 1) && (tonic == "a")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == 2) && (tonic == "e")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == 3) && (tonic == "b")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == 4) && (tonic == "fis")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == 5) && (tonic == "cis")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == 6) && (tonic == "gis")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == 7) && (tonic == "dis")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == -1) && (tonic == "g")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == -2) && (tonic == "c")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == -3) && (tonic == "f")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == -4) && (tonic == "bes")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == -5) && (tonic == "ees")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == -6) && (tonic == "aes")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == -7) && (tonic == "des")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		}
-	}
+	return status;
+}
 
-	if (mode == "phrygian") {
-		if ((accids == 0) && (tonic == "e")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == 1) && (tonic == "b")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == 2) && (tonic == "fis")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == 3) && (tonic == "cis")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == 4) && (tonic == "gis")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == 5) && (tonic == "dis")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == 6) && (tonic == "ais")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == 7) && (tonic == "eis")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == -1) && (tonic == "a")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == -2) && (tonic == "d")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == -3) && (tonic == "g")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == -4) && (tonic == "c")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == -5) && (tonic == "f")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == -6) && (tonic == "bes")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == -7) && (tonic == "ees")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		}
-	}
 
-	if (mode == "lydian") {
-		if ((accids == 0) && (tonic == "f")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == 1) && (tonic == "c")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == 2) && (tonic == "g")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == 3) && (tonic == "d")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == 4) && (tonic == "a")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == 5) && (tonic == "e")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == 6) && (tonic == "b")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == 7) && (tonic == "fis")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == -1) && (tonic == "bes")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == -2) && (tonic == "ees")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == -3) && (tonic == "aes")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == -4) && (tonic == "des")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == -5) && (tonic == "ges")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == -6) && (tonic == "ces")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == -7) && (tonic == "fes")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		}
-	}
 
-	if (mode == "mixolydian") {
-		if ((accids == 0) && (tonic == "g")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == 1) && (tonic == "d")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == 2) && (tonic == "a")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == 3) && (tonic == "e")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == 4) && (tonic == "b")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == 5) && (tonic == "fis")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == 6) && (tonic == "cis")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == 7) && (tonic == "gis")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == -1) && (tonic == "c")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == -2) && (tonic == "f")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == -3) && (tonic == "bes")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == -4) && (tonic == "ees")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == -5) && (tonic == "aes")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == -6) && (tonic == "des")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == -7) && (tonic == "ges")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
+//////////////////////////////
+//
+// HumdrumToLilypondConverter::getKeySignatureAccidentals -- Returns the
+//    number of sharps (positive) or flats (negative) in a key signature
+//    such as "*k[f#c#]".  Returns 99 for non-standard key signatures.
+//
+
+int HumdrumToLilypondConverter::getKeySignatureAccidentals(
+		const string& token) {
+	int mask = 0;
+	int size = (int)token.size();
+	for (int i=0; i<size-1; i++) {
+		char letter = token[i];
+		if ((letter < 'a') || (letter > 'g')) {
+			continue;
+		}
+		if (token[i+1] == '#') {
+			mask |= 1 << KeySharpBits[letter - 'a'];
+		} else if (token[i+1] == '-') {
+			mask |= 1 << KeyFlatBits[letter - 'a'];
 		}
 	}
 
-	if (mode == "locrian") {
-		if ((accids == 0) && (tonic == "b")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == 1) && (tonic == "fis")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == 2) && (tonic == "cis")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == 3) && (tonic == "gis")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == 4) && (tonic == "dis")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == 5) && (tonic == "ais")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == 6) && (tonic == "eis")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == 7) && (tonic == "bis")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == -1) && (tonic == "e")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == -2) && (tonic == "a")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == -3) && (tonic == "d")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == -4) && (tonic == "g")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == -5) && (tonic == "c")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == -6) && (tonic == "f")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
-		} else if ((accids == -7) && (tonic == "bes")) {
-			out << "\\key " << tonic << " \\" << mode; return status;
+	int sharps = mask & 0x7f;
+	int flats  = mask >> 7;
+	if (sharps && flats) {
+		return 99;
+	}
+	for (int i=0; i<=7; i++) {
+		if (sharps == (1 << i) - 1) {
+			if (flats == 0) {
+				return i;
+			}
+		}
+		if ((sharps == 0) && (flats == (1 << i) - 1)) {
+			return -i;
 		}
 	}
+	return 99;
+}
 
-	string error = "Error: Unknown key signatue " + (*token);
-	if (designation) {
-		error += " in combination with the key " + (*designation);
-	}
-	addErrorMessage(error, token);
 
-	return status;
+
+//////////////////////////////
+//
+// HumdrumToLilypondConverter::getKeyMode -- Returns the index into
+//    KeyModeNames for a key designation such as "*G:" (major), "*g:"
+//    (minor) or "*d:dor" (dorian).
+//
+
+int HumdrumToLilypondConverter::getKeyMode(const string& designation) {
+	int mode = 0;
+	if ((designation.size() > 1) && islower(designation[1])) {
+		mode = 1;
+	}
+	size_t colon = designation.find(':');
+	if (colon == string::npos) {
+		return mode;
+	}
+	string name = designation.substr(colon + 1, 3);
+	if (name == "dor") {
+		mode = 2;
+	} else if (name == "phr") {
+		mode = 3;
+	} else if (name == "lyd") {
+		mode = 4;
+	} else if (name == "mix") {
+		mode = 5;
+	} else if (name == "loc") {
+		mode = 6;
+	} else if (name == "ion") {
+		mode = 7;
+	} else if (name == "aeo") {
+		mode = 8;
+	}
+	return mode;
 }
 
 
+
 //////////////////////////////
 //
-// HumdrumToLilypondConverter::getKeyDesignation --
+// HumdrumToLilypondConverter::getKeyDesignation -- Find the key
+//    designation (such as "*G:") next to a key signature in the same
+//    spine.  Only the tokens up to the data lines before and after the
+//    key signature are searched, since they all have the same timestamp.
+//    This does not need rhythm analysis, so it works with files read
+//    by readInput().
 //
 
 HTp HumdrumToLilypondConverter::getKeyDesignation(HTp token) {
 	if (!token) {
 		return NULL;
 	}
-	HumNum timestamp = token->getDurationFromStart();
 
 	HTp ttok = token->getNextToken();
-	while (ttok && (ttok->getDurationFromStart() == timestamp)) {
+	while (ttok) {
 		if (ttok->isData()) {
 			break;
 		}
@@ -906,7 +1469,7 @@ HTp HumdrumToLilypondConverter::getKeyDesignation(HTp token) {
 	}
 
 	ttok = token->getPreviousToken();
-	while (ttok && (ttok->getDurationFromStart() == timestamp)) {
+	while (ttok) {
 		if (ttok->isData()) {
 			break;
 		}
@@ -928,7 +1491,7 @@ HTp HumdrumToLilypondConverter::getKeyDesignation(HTp token) {
 // http://lilypond.org/doc/v2.19/Documentation/notation/clef-styles
 //
 
-bool HumdrumToLilypondConverter::convertClef(ostream& out, HTp token) {
+bool HumdrumToLilypondConverter::convertClef(OutputBuffer& out, HTp token) {
 	bool status = true;
 	if (*token == "*clefG2") {
 		out << "\\clef \"treble\"";
@@ -953,6 +1516,7 @@ bool HumdrumToLilypondConverter::convertClef(ostream& out, HTp token) {
 	} else if (*token == "*clefF3") {
 		out << "\\clef varbaritone\"";
 	} else {
+		m_statistics.unknownclefs++;
 		addErrorMessage("Error: unknown clef: " + *token, token);
 	}
 
@@ -961,12 +1525,96 @@ bool HumdrumToLilypondConverter::convertClef(ostream& out, HTp token) {
 
 
 
+//////////////////////////////
+//
+// HumdrumToLilypondConverter::endTokenLine -- Each converted token is
+//    printed on its own line.  With the -k option, the **kern token is
+//    added as a comment (and tokens which do not produce any lilypond
+//    output, such as barlines, are shown as comment lines).
+//
+
+void HumdrumToLilypondConverter::endTokenLine(OutputBuffer& out, HTp token) {
+	if (m_kernecho) {
+		out << "\t\t% " << *token;
+	}
+	out << '\n';
+}
+
+
+
+//////////////////////////////
+//
+// HumdrumToLilypondConverter::addSourceMapEntry -- Record the current
+//    output position as the location of the token's conversion.
+//
+
+void HumdrumToLilypondConverter::addSourceMapEntry(OutputBuffer& out,
+		HTp token) {
+	if (!m_sourcemapout) {
+		return;
+	}
+	SourceMapEntry entry;
+	entry.offset = (long)out.getOffset();
+	entry.line   = token->getLineNumber();
+	entry.field  = token->getFieldNumber();
+	m_sourcemap.push_back(entry);
+}
+
+
+
+//////////////////////////////
+//
+// HumdrumToLilypondConverter::addSourceMap -- Add the source map of a
+//    separately converted segment which is about to be written to the
+//    output.  The offsets of the entries are relative to the start of
+//    the segment.
+//
+
+void HumdrumToLilypondConverter::addSourceMap(OutputBuffer& out,
+		const vector<SourceMapEntry>& entries) {
+	if (!m_sourcemapout || entries.empty()) {
+		return;
+	}
+	long base = (long)out.getOffset();
+	for (int i=0; i<(int)entries.size(); i++) {
+		m_sourcemap.push_back(entries[i]);
+		m_sourcemap.back().offset += base;
+	}
+}
+
+
+
+//////////////////////////////
+//
+// HumdrumToLilypondConverter::printSourceMap -- Print the source map as
+//    JSON.  Each mapping is [output offset, Humdrum line, Humdrum field],
+//    with offsets counted from the start of the conversion's output.
+//
+
+void HumdrumToLilypondConverter::printSourceMap(ostream& out,
+		long startoffset) {
+	out << "{\n";
+	out << "\t\"version\": 1,\n";
+	out << "\t\"mappings\": [";
+	for (int i=0; i<(int)m_sourcemap.size(); i++) {
+		SourceMapEntry& entry = m_sourcemap[i];
+		out << (i == 0 ? "\n" : ",\n");
+		out << "\t\t[" << entry.offset - startoffset << ", " << entry.line
+		    << ", " << entry.field << "]";
+	}
+	out << "\n\t]\n";
+	out << "}\n";
+}
+
+
+
 //////////////////////////////
 //
 // HumdrumToLilypondConverter::convetDataToken --
 //
 
-bool HumdrumToLilypondConverter::convertDataToken(ostream& out, HTp token) {
+bool HumdrumToLilypondConverter::convertDataToken(OutputBuffer& out,
+		HTp token, StateVariables& states) {
 	if (token->isNull()) {
 		return true;
 	}
@@ -974,11 +1622,14 @@ bool HumdrumToLilypondConverter::convertDataToken(ostream& out, HTp token) {
 		return true;
 	}
 	if (token->isRest()) {
-		return convertRest(out, token);
+		m_statistics.rests++;
+		return convertRest(out, token, states);
 	} else if (token->isChord()) {
+		m_statistics.chords++;
 		return convertChord(out, token);
 	} else {
-		return convertNote(out, token);
+		m_statistics.notes++;
+		return convertNote(out, token, states);
 	}
 }
 
@@ -989,24 +1640,20 @@ bool HumdrumToLilypondConverter::convertDataToken(ostream& out, HTp token) {
 //  HumdrumToLilypondConverter::convertRest --
 //
 
-bool HumdrumToLilypondConverter::convertRest(ostream& out, HTp token) {
-	StateVariables& states = m_states;
-
-	// Rests should not be in chords, so filter out any chordness.
-	string stok = token->getSubtoken(0);
+bool HumdrumToLilypondConverter::convertRest(OutputBuffer& out, HTp token,
+		StateVariables& states) {
+	// Rests should not be in chords, so only the first subtoken is decoded.
+	KernNote note;
+	note.decode(*token);
 
 	out << "r";
 
 	// print duration
-	HumNum duration = Convert::recipToDuration(stok);
-	HumNum durationnodots;
-	int dots = characterCount(stok, '.');
-	if ((dots != states.dots) || (duration != states.duration)) {
-		durationnodots = Convert::recipToDurationNoDots(stok);
-		convertDuration(out, duration, durationnodots, dots);
+	if (!states.hasDuration(note)) {
+		convertDuration(out, *token, note, states);
 	}
 
-	convertArticulations(out, *token);
+	convertArticulations(out, note);
 
 	return true;
 }
@@ -1019,7 +1666,7 @@ bool HumdrumToLilypondConverter::convertRest(ostream& out, HTp token) {
 //
 
 
-bool HumdrumToLilypondConverter::convertChord(ostream& out, HTp token) {
+bool HumdrumToLilypondConverter::convertChord(OutputBuffer& out, HTp token) {
 	cerr << "Cannot convert chords yet" << endl;
 	return false;
 }
@@ -1031,18 +1678,16 @@ bool HumdrumToLilypondConverter::convertChord(ostream& out, HTp token) {
 //  HumdrumToLilypondConverter::convertNote --
 //
 
-bool HumdrumToLilypondConverter::convertNote(ostream& out, HTp token,
-		int index) {
-	StateVariables& states = m_states;
-
+bool HumdrumToLilypondConverter::convertNote(OutputBuffer& out, HTp token,
+		StateVariables& states, int index) {
 	out << m_indent;  // indenting every note for now
 
-	string stok = token->getSubtoken(0);
+	KernNote note;
+	note.decode(*token);
 
 	// print pitch
-	int pitch = Convert::kernToBase40(stok);
-   int diatonic = Convert::kernToDiatonicPC(stok);
-	switch(diatonic) {
+	int pitch = note.base40;
+	switch(note.diatonic) {
 		case 0: out << "c"; break;
 		case 1: out << "d"; break;
 		case 2: out << "e"; break;
@@ -1051,15 +1696,14 @@ bool HumdrumToLilypondConverter::convertNote(ostream& out, HTp token,
 		case 5: out << "a"; break;
 		case 6: out << "b"; break;
 	}
-	int accidental = Convert::kernToAccidentalCount(stok);
-	switch (accidental) {
+	switch (note.accidental) {
 		case 2: out << "isis"; break;
 		case 1: out << "is"; break;
 		case 0:  break;
 		case -1: out << "es"; break;
 		case -2: out << "eses"; break;
 	}
-   int interval;
+	int interval;
 	int sign;
 	if (states.pitch != pitch) {
 		interval = (pitch - states.pitch);
@@ -1071,41 +1715,34 @@ bool HumdrumToLilypondConverter::convertNote(ostream& out, HTp token,
 
 		// only one octave melodic change for now:
 		if (interval <= 20) {
-        // do nothing
+			// do nothing
 		} else if ((interval > 20) && (sign > 0)) {
-         out << "'";
+			out << "'";
 		} else if ((interval > 20) && (sign < 0)) {
-         out << ",";
-        // do nothing
+			out << ",";
 		}
 		states.pitch = pitch;
 	}
 
 	// print duration
-	HumNum duration = Convert::recipToDuration(stok);
-	HumNum durationnodots;
-	int dots = characterCount(stok, '.');
-	if ((dots != states.dots) || (duration != states.duration)) {
-		durationnodots = Convert::recipToDurationNoDots(stok);
-		convertDuration(out, duration, durationnodots, dots);
+	if (!states.hasDuration(note)) {
+		convertDuration(out, *token, note, states);
 	}
 
-   // ties:
-	if (stok.find("[") != string::npos) {
-		out << "~";
-	} else if (stok.find("_") != string::npos) {
+	// ties:
+	if (note.flags & (KernNote::TieStart | KernNote::TieContinue)) {
 		out << "~";
 	}
 
-   // slurs:
-	if (stok.find(")") != string::npos) {
+	// slurs:
+	if (note.flags & KernNote::SlurEnd) {
 		out << ")";
 	}
-	if (stok.find("(") != string::npos) {
+	if (note.flags & KernNote::SlurStart) {
 		out << "(";
 	}
 
-	convertArticulations(out, stok);
+	convertArticulations(out, note);
 
 	return true;
 }
@@ -1117,42 +1754,76 @@ bool HumdrumToLilypondConverter::convertNote(ostream& out, HTp token,
 // HumdrumToLilypondConverter::convertArticulations --
 //
 
-void HumdrumToLilypondConverter::convertArticulations(ostream& out,
-		const string& stok) {
-	if (stok.find(";") != string::npos) {
+void HumdrumToLilypondConverter::convertArticulations(OutputBuffer& out,
+		const KernNote& note) {
+	if (note.flags & KernNote::Fermata) {
 		out << "\\fermata";
 	}
 }
 
 
 
+// Maximum number of entries in m_durationcache:
+static constexpr int MaxDurationCache = 1024;
+
+
+
 //////////////////////////////
 //
-// HumdrumToLilypondConverter::convertDuration --
+// HumdrumToLilypondConverter::convertDuration -- Print the lilypond
+//    duration of a note or rest and remember it as the current duration.
+//    Scores use only a few distinct rhythms, so the lilypond text for each
+//    rhythm (including dots) is cached, keyed by the rhythm characters of
+//    the token.  The cache is cleared when it reaches MaxDurationCache
+//    entries, so a converter which is kept for many files (or input with
+//    many unusual rhythms) does not grow without limit.
 //
 
-void HumdrumToLilypondConverter::convertDuration(ostream& out, HumNum& duration, 
-		HumNum& durationnodots, int dots) {
-	StateVariables& states = m_states;
+void HumdrumToLilypondConverter::convertDuration(OutputBuffer& out,
+		const string& token, const KernNote& note, StateVariables& states) {
+	states.dots   = note.dots;
+	states.durnum = note.durnum;
+	states.durden = note.durden;
 
-	states.dots = dots;
-	states.duration = duration;
+	if (note.durnum <= 0) {
+		// grace note or no rhythm
+		return;
+	}
 
-	int top = durationnodots.getNumerator();
-	int bot = durationnodots.getDenominator();
-	HumNum newdur = bot;
-	newdur /= top;
+	string& key = m_durationkey;
+	key.assign(token, note.recipstart, note.reciplen);
+	key.append(note.dots, '.');
 
-	newdur *= 4;
-	if (newdur.getDenominator() != 1) {
-		// complicated rhythm such as triplet whole note, so deal with later 
-		return;
+	auto entry = m_durationcache.find(key);
+	if (entry == m_durationcache.end()) {
+		if ((int)m_durationcache.size() >= MaxDurationCache) {
+			m_durationcache.clear();
+		}
+		entry = m_durationcache.emplace(key, getDurationText(note)).first;
 	}
+	if (entry->second.empty()) {
+		m_statistics.droppeddurations++;
+	}
+	out << entry->second;
+}
+
+
+
+//////////////////////////////
+//
+// HumdrumToLilypondConverter::getDurationText -- Return the lilypond
+//    duration of a note, or an empty string if the rhythm cannot be
+//    expressed yet.
+//
 
-	out << newdur;
-	for (int i=0; i<(int)dots; i++) {
-		out << ".";
+string HumdrumToLilypondConverter::getDurationText(const KernNote& note) {
+	if ((note.durnum <= 0) || (note.durden % note.durnum != 0)) {
+		// complicated rhythm such as triplet whole note, so deal with later
+		return "";
 	}
+	string output = to_string(note.durden / note.durnum);
+	output.append(note.dots, '.');
+	return output;
 }
 
 
@@ -1202,15 +1873,18 @@ string HumdrumToLilypondConverter::arabicToRomanNumeral(int arabic,
 
 //////////////////////////////
 //
-// HumdrumToLilypondConverter::addErrorMessage --
+// HumdrumToLilypondConverter::addErrorMessage -- If a token is given, its
+//    line and field are added as continuation lines of the message.  The
+//    errors statistic counts messages (not their continuation lines).
 //
 
 void HumdrumToLilypondConverter::addErrorMessage(const string& message,
 		HTp token) {
+	m_statistics.errors++;
 	m_errors.push_back(message);
 	if (token != NULL) {
-		addErrorMessage("\tLine:  " + to_string(token->getLineNumber()));
-		addErrorMessage("\tField: " + to_string(token->getFieldNumber()));
+		m_errors.push_back("\tLine:  " + to_string(token->getLineNumber()));
+		m_errors.push_back("\tField: " + to_string(token->getFieldNumber()));
 	}
 }
 
@@ -1218,48 +1892,65 @@ void HumdrumToLilypondConverter::addErrorMessage(const string& message,
 
 //////////////////////////////
 //
-// HumdrumToLilypondConverter::printErrorMessages(ostream& out) {
+// HumdrumToLilypondConverter::printErrorMessages -- Errors are printed
+//    as lilypond comments in a trailer after the score (since the output
+//    is streamed, the errors are not known when the start of the output
+//    is written).  If an error stream has been set with setErrorStream(),
+//    the messages are sent there instead.
 //
 
-void HumdrumToLilypondConverter::printErrorMessages(ostream& out) {
-	for (int i=0; i<(int)m_errors.size(); i++) {
-		out << "% " << m_errors[i] << endl;
+void HumdrumToLilypondConverter::printErrorMessages(OutputBuffer& out) {
+	if (m_errors.size() == 0) {
+		return;
+	}
+	HUM2LY_PROFILE_SCOPE(m_profiler, "printErrorMessages");
+	if (m_errorout) {
+		for (int i=0; i<(int)m_errors.size(); i++) {
+			*m_errorout << "% " << m_errors[i] << "\n";
+		}
+		m_errorout->flush();
+		return;
 	}
-	if (m_errors.size() > 0) {
-		out << endl;
+	out << '\n';
+	for (int i=0; i<(int)m_errors.size(); i++) {
+		out << "% " << m_errors[i] << '\n';
 	}
+	out.flush();
 }
 
 
 
 //////////////////////////////
 //
-// HumdumToLilypondConverter::setOptions --
+// HumdumToLilypondConverter::setOptions -- Read the settings from
+//    command-line arguments.  To use the same settings for many
+//    converters, make a ConversionConfig once and give it to each
+//    converter with setConfig().
 //
 
 void HumdrumToLilypondConverter::setOptions(int argc, char** argv) {
-	m_options.process(argc, argv);
+	Options options = getOptionDefinitions();
+	options.process(argc, argv);
+	m_config = ConversionConfig::fromOptions(options);
 }
 
 
 void HumdrumToLilypondConverter::setOptions(const vector<string>& argvlist) {
-	int tempargc = (int)argvlist.size();
-	char* tempargv[tempargc+1];
-	tempargv[tempargc] = NULL;
-	
-	int i;
-	for (i=0; i<tempargc; i++) {
-		tempargv[i] = new char[argvlist[i].size() + 1];
-		strcpy(tempargv[i], argvlist[i].c_str());
+	// Options::process only reads the arguments, so they do not need
+	// to be copied.
+	vector<char*> args;
+	args.reserve(argvlist.size() + 1);
+	for (int i=0; i<(int)argvlist.size(); i++) {
+		args.push_back(const_cast<char*>(argvlist[i].c_str()));
 	}
+	args.push_back(NULL);
+	setOptions((int)argvlist.size(), args.data());
+}
 
-	setOptions(tempargc, tempargv);
 
-	for (i=0; i<tempargc; i++) {
-		if (tempargv[i] != NULL) {
-			delete [] tempargv[i];
-		}
-	}
+void HumdrumToLilypondConverter::setOptions(const Options& options) {
+	Options processed = options;
+	m_config = ConversionConfig::fromOptions(processed);
 }
 
 
@@ -1269,8 +1960,81 @@ void HumdrumToLilypondConverter::setOptions(const vector<string>& argvlist) {
 //   duplicating the definitions in the test main() function.
 //
 
-Options HumdrumToLilypondConverter::getOptionDefinitions (void) {
-	return m_options;
+Options HumdrumToLilypondConverter::getOptionDefinitions(void) {
+	Options options;
+	ConversionConfig::defineOptions(options);
+	return options;
+}
+
+
+
+//////////////////////////////
+//
+// HumdrumToLilypondConverter::getOptionsKey -- Return the settings which
+//    affect the output of a conversion, for use in cache keys.
+//
+
+string HumdrumToLilypondConverter::getOptionsKey(void) {
+	return m_config->key + "\nindent=" + m_indent;
+}
+
+
+
+//////////////////////////////
+//
+// HumdrumToLilypondConverter::readInput -- Read Humdrum data for
+//    conversion.  The converter only needs the line types, spines and
+//    token links of a file, so humlib's rhythm analysis is skipped unless
+//    fullparse is true.  If the data cannot be read that way, it is read
+//    again with the full analysis (if the stream can be rewound), which
+//    reports errors in the same way as before.
+//
+
+bool HumdrumToLilypondConverter::readInput(HumdrumFile& infile,
+		istream& input, bool fullparse) {
+	if (fullparse) {
+		return infile.read(input);
+	}
+	streampos start = input.tellg();
+	if (infile.readNoRhythm(input)) {
+		return true;
+	}
+	if (start < 0) {
+		return false;
+	}
+	input.clear();
+	input.seekg(start);
+	if (!input) {
+		return false;
+	}
+	return infile.read(input);
+}
+
+
+bool HumdrumToLilypondConverter::readInput(HumdrumFile& infile,
+		const string& filename, bool fullparse) {
+	if (fullparse) {
+		return infile.read(filename);
+	}
+	if (infile.readNoRhythm(filename)) {
+		return true;
+	}
+	return infile.read(filename);
+}
+
+
+
+//////////////////////////////
+//
+// HumdrumToLilypondConverter::getConverterVersion -- Change this whenever
+//    the output of the converter changes, so that cached conversions made
+//    by older versions are not used.  The version is part of the
+//    --cache-dir key, so every commit which changes the output (including
+//    error messages and the statistics) must update it.
+//
+
+const char* HumdrumToLilypondConverter::getConverterVersion(void) {
+	return "hum2ly 2026-10-19";
 }
 
 
@@ -13,17 +13,62 @@
 #ifndef _HUM2LY_H
 #define _HUM2LY_H
 
+#ifndef _USE_HUMLIB_OPTIONS_
 #define _USE_HUMLIB_OPTIONS_
+#endif
 #include "humlib.h"
+#include "config.h"
+#include "outputbuffer.h"
+#include "profiler.h"
+#include "segmentcache.h"
+#include "sourcemap.h"
+#include "statistics.h"
+#include "taskpool.h"
 
 #include <iostream>
 #include <math.h>
+#include <memory>
+#include <unordered_map>
 
 namespace hum {
 
 using namespace std;
 
 
+//////////////////////////////
+//
+// KernNote -- The pitch, rhythm and notation flags of a **kern note or
+//    rest, decoded in a single pass over the token.
+//
+
+class KernNote {
+	public:
+		enum Flags {
+			TieStart    = 0x01,  // [
+			TieContinue = 0x02,  // _
+			TieEnd      = 0x04,  // ]
+			SlurStart   = 0x08,  // (
+			SlurEnd     = 0x10,  // )
+			Fermata     = 0x20,  // ;
+			Rest        = 0x40,  // r
+			Grace       = 0x80   // q
+		};
+
+		void decode(const string& token);
+
+		int base40;       // base-40 pitch (-1000 if not a note)
+		int diatonic;     // diatonic pitch class (0=C to 6=B, -1 if none)
+		int accidental;   // sharps (positive) or flats (negative)
+		int durnum;       // duration without dots (numerator, whole notes)
+		int durden;       // duration without dots (denominator)
+		int dots;         // augmentation dots
+		int flags;        // KernNote::Flags
+		int recipstart;   // index of rhythm in token
+		int reciplen;     // length of rhythm in token (without dots)
+};
+
+
+
 //////////////////////////////
 //
 // StateVariables -- This helper class keeps track of various
@@ -35,8 +80,10 @@ class StateVariables {
 		StateVariables(void) { clear(); }
 		~StateVariables() { clear(); }
 		void clear();
+		bool hasDuration(const KernNote& note) const;
 
-		HumNum duration;  // duration of last note/chord/rest
+		int durnum;       // duration of last note/chord/rest (numerator)
+		int durden;       // duration of last note/chord/rest (denominator)
 		int dots;         // augmentation dots of last note/chord/rest
 		int pitch;        // pitch of previous note
 		int cpitch;       // pitch of previous note in chord
@@ -59,56 +106,117 @@ class HumdrumToLilypondConverter {
 		bool    convert              (ostream& out, HumdrumFile& infile);
 		bool    convert              (ostream& out, const string& input);
 		bool    convert              (ostream& out, istream& input);
+		bool    convert              (OutputBuffer& out, HumdrumFile& infile);
+		void    clear                (void);
 		void    setIndent            (const string& indent)
 		                                   { m_indent = indent; }
+		void    setErrorStream       (ostream* errout)
+		                                   { m_errorout = errout; }
+		void    setProfiler          (Profiler* profiler)
+		                                   { m_profiler = profiler; }
+		void    setSourceMapStream   (ostream* mapout)
+		                                   { m_sourcemapout = mapout; }
+		const ConversionStatistics& getStatistics(void) const
+		                                   { return m_statistics; }
+		void    setSegmentCache      (bool state);
+		vector<pair<int, int>> getRecomputedSegments(void);
 		void    setOptions           (int argc, char** argv);
 		void    setOptions           (const vector<string>& argvlist);
-		Options getOptionDefinitions (void);
+		void    setOptions           (const Options& options);
+		void    setConfig            (shared_ptr<const ConversionConfig> config)
+		                                   { m_config = config; }
+		const ConversionConfig& getConfig(void) const { return *m_config; }
+		static Options getOptionDefinitions(void);
+		string  getOptionsKey        (void);
+		static const char* getConverterVersion(void);
+		static bool readInput(HumdrumFile& infile, istream& input,
+		                      bool fullparse = false);
+		static bool readInput(HumdrumFile& infile, const string& filename,
+		                      bool fullparse = false);
 
 	protected:
-		bool convert          (ostream& out);
-		bool convertPart      (ostream& out, const string& partname,
+		bool convertToStream  (ostream& out);
+		bool convert          (OutputBuffer& out);
+		bool convertPart      (OutputBuffer& out, const string& partname,
 		                       int partindex);
+		bool convertSegmentVariable(OutputBuffer& out, const string& partname,
+		                       int partindex, int segment);
+		bool convertSegmentUncached(OutputBuffer& out, const string& partname,
+		                       int partindex, int segment);
+		uint64_t getSegmentKey(const string& partname, int partindex,
+		                       int segment, string& keytext);
+		bool convertSegmentsParallel(OutputBuffer& out, int threads);
+		bool convertLineMajor (OutputBuffer& out);
+		string getSegmentName (const string& partname, int segment);
+		int  getSegmentCount  (void);
+		void prepareWorker    (HumdrumToLilypondConverter& worker);
 		void extractSegments  (void);
-		bool convertSegment   (ostream& out, int partindex, int startline,
-		                       int endline);
-		void printHeaderComments(ostream& out);
-		void printFooterComments(ostream& out);
-		bool convertPartSegment(ostream& out, HTp starttoken, int endline);
-		bool convertDataToken (ostream& out, HTp token);
-		bool convertRest      (ostream& out, HTp token);
-		bool convertChord     (ostream& out, HTp token);
-		bool convertNote      (ostream& out, HTp token, int index = 0);
-		int  printRelativeStartingPitch(ostream& out, int partindex,
-		                       int startline, int endline);
-		vector<HTp> getStartTokens(int partindex, int startline, int endline);
-		int getSegmentStartingPitch(int partindex, int startline, int endline);
+		void indexStartTokens (void);
+		bool convertSegment   (OutputBuffer& out, int partindex, int segment,
+		                       StateVariables& states);
+		void printHeaderComments(OutputBuffer& out);
+		void printFooterComments(OutputBuffer& out);
+		bool convertPartSegment(OutputBuffer& out, HTp starttoken, int endline,
+		                       StateVariables& states);
+		bool convertSpineToken(OutputBuffer& out, HTp token,
+		                       StateVariables& states);
+		bool convertDataToken (OutputBuffer& out, HTp token,
+		                       StateVariables& states);
+		void endTokenLine     (OutputBuffer& out, HTp token);
+		void addSourceMapEntry(OutputBuffer& out, HTp token);
+		void addSourceMap     (OutputBuffer& out,
+		                       const vector<SourceMapEntry>& entries);
+		void printSourceMap   (ostream& out, long startoffset);
+		bool convertRest      (OutputBuffer& out, HTp token,
+		                       StateVariables& states);
+		bool convertChord     (OutputBuffer& out, HTp token);
+		bool convertNote      (OutputBuffer& out, HTp token,
+		                       StateVariables& states, int index = 0);
+		int  printRelativeStartingPitch(OutputBuffer& out, int partindex,
+		                       int segment);
+		HTp  getStartToken    (int partindex, int segment);
+		int  getSegmentStartingPitch(int partindex, int segment);
 		int characterCount    (const string &text, char symbol);
-		void convertDuration  (ostream& out, HumNum& duration, int dots);
-		void convertDuration  (ostream& out, HumNum& durationnodots,
-		                       HumNum& duration, int dots);
+		void convertDuration  (OutputBuffer& out, const string& token,
+		                       const KernNote& note, StateVariables& states);
+		string getDurationText(const KernNote& note);
 		string arabicToRomanNumeral(int arabic, int casetype = 1);
-		bool convertInterpretationToken(ostream& out, HTp token);
+		bool convertInterpretationToken(OutputBuffer& out, HTp token);
 		void addErrorMessage  (const string& message, HTp token = NULL);
-		void printErrorMessages(ostream& out);
-		bool convertClef      (ostream& out, HTp token);
+		void printErrorMessages(OutputBuffer& out);
+		bool convertClef      (OutputBuffer& out, HTp token);
 		HTp  getKeyDesignation (HTp token);
-		bool convertKeySignature(ostream& out, HTp token);
-		void printHeader      (ostream& tempout);
-		void convertArticulations(ostream& out, const string& stok);
+		bool convertKeySignature(OutputBuffer& out, HTp token);
+		int  getKeySignatureAccidentals(const string& token);
+		int  getKeyMode       (const string& designation);
+		void printHeader      (OutputBuffer& out);
+		void convertArticulations(OutputBuffer& out, const KernNote& note);
 
 	private:
 		vector<HTp>     m_kernstarts;  // part to track mapping
 		vector<int>     m_rkern;       // track to part mapping
 		vector<int>     m_segments;    // line index for start of each segement
 		vector<string>  m_labels;      // starting label for each segement
-		HumdrumFile     m_infile;      // Humdrum file to convert
+		vector<HTp>     m_starttokens; // start token for each segment/part
+		HumdrumFile*    m_infile;      // Humdrum file to convert (not owned)
+		HumdrumFile     m_ownedfile;   // storage for istream/string input
 		string          m_indent;      // whitespace for each indenting levels
-		stringstream    m_staffout;    // staff assembly output
-		stringstream    m_scoreout;    // score assembly output
+		string          m_staffout;    // staff assembly output
+		string          m_scoreout;    // score assembly output
 		StateVariables  m_states;      // keep track of pitch/rhythm changes
-		Options         m_options;     // command-line options
+		shared_ptr<const ConversionConfig> m_config; // shared settings
 		vector<string>  m_errors;      // storage for conversion errors
+		ostream*        m_errorout;    // error sink (NULL = output trailer)
+		Profiler*       m_profiler;    // phase timers (NULL = not profiling)
+		ConversionStatistics m_statistics; // counts for the last conversion
+		shared_ptr<SegmentCache> m_segmentcache; // NULL = no caching
+		bool            m_kernecho;    // print **kern tokens as comments
+		ostream*        m_sourcemapout; // source map output (NULL = none)
+		vector<SourceMapEntry> m_sourcemap; // output offset of tokens
+		unique_ptr<TaskPool> m_pool;   // threads for -t (kept for reuse)
+		vector<unique_ptr<HumdrumToLilypondConverter>> m_workers; // for -t
+		unordered_map<string, string> m_durationcache; // rhythm -> lilypond
+		string          m_durationkey; // lookup key for m_durationcache
 };
 
 
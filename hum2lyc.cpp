@@ -0,0 +1,199 @@
+//
+// Programmer:    Craig Stuart Sapp <craig@ccrma.stanford.edu>
+// Creation Date: Sat Oct 17 16:40:05 CEST 2026
+// Last Modified: Sat Oct 17 16:40:05 CEST 2026
+// Filename:      hum2lyc.cpp
+// URL:           https://github.com/craigsapp/hum2ly/blob/master/hum2lyc.cpp
+// Syntax:        C++11
+// vim:           ts=3 noexpandtab
+//
+// Description:   C interface to libhum2ly.  Exceptions are not allowed to
+//                pass into the calling (C) code: they are reported as a
+//                failed call with the exception's message as diagnostics.
+//
+
+#include "hum2lyc.h"
+#include "hum2ly.h"
+#include "inputbuffer.h"
+
+#include <exception>
+#include <new>
+#include <sstream>
+
+using namespace std;
+using namespace hum;
+
+
+//////////////////////////////
+//
+// hum2ly_converter -- A converter with the buffers for its input, output
+//    and error messages.
+//
+
+struct hum2ly_converter {
+	hum2ly_converter(void) : instream(&inbuf) {
+		definitions = HumdrumToLilypondConverter::getOptionDefinitions();
+	}
+
+	void setError(const string& message) {
+		diagnostics.str("");
+		diagnostics << message << "\n";
+	}
+
+	HumdrumToLilypondConverter converter;
+	Options         definitions;  // option definitions for set_options
+	MemoryStreambuf inbuf;        // input data without copying
+	istream         instream;
+	OutputBuffer    output;       // lilypond data of the last conversion
+	stringstream    diagnostics;  // errors of the last call
+	string          diagnostictext;
+};
+
+
+
+//////////////////////////////
+//
+// hum2ly_create --
+//
+
+hum2ly_converter* hum2ly_create(void) {
+	try {
+		return new hum2ly_converter;
+	} catch (...) {
+		return NULL;
+	}
+}
+
+
+
+//////////////////////////////
+//
+// hum2ly_destroy --
+//
+
+void hum2ly_destroy(hum2ly_converter* converter) {
+	delete converter;
+}
+
+
+
+//////////////////////////////
+//
+// hum2ly_set_options -- The arguments are processed in the same way as
+//    the options of a conversion server request.
+//
+
+int hum2ly_set_options(hum2ly_converter* converter, int argc,
+		const char* const* argv) {
+	if (converter == NULL) {
+		return 0;
+	}
+	try {
+		converter->diagnostics.str("");
+		vector<string> arglist;
+		arglist.push_back("hum2ly");
+		for (int i=0; i<argc; i++) {
+			arglist.push_back(argv[i] ? argv[i] : "");
+		}
+		vector<char*> args;
+		for (int i=0; i<(int)arglist.size(); i++) {
+			args.push_back(&arglist[i][0]);
+		}
+		args.push_back(NULL);
+		Options options = converter->definitions;
+		// Do not exit the calling program on unknown options:
+		options.process((int)arglist.size(), args.data(), 0);
+		converter->converter.setConfig(ConversionConfig::fromOptions(options));
+	} catch (exception& error) {
+		converter->setError(string("Error: ") + error.what());
+		return 0;
+	} catch (...) {
+		converter->setError("Error: could not set options");
+		return 0;
+	}
+	return 1;
+}
+
+
+
+//////////////////////////////
+//
+// hum2ly_convert -- Errors are sent to the diagnostics instead of being
+//    added to the end of the lilypond data.
+//
+
+int hum2ly_convert(hum2ly_converter* converter, const char* input,
+		size_t size, const char** output, size_t* outputsize) {
+	if (converter == NULL) {
+		return 0;
+	}
+	bool status = false;
+	try {
+		converter->diagnostics.str("");
+		converter->output.clear();
+		converter->inbuf.setData(input ? input : "", input ? size : 0);
+		converter->instream.clear();
+		HumdrumFile infile;
+		if (!HumdrumToLilypondConverter::readInput(infile,
+				converter->instream,
+				converter->converter.getConfig().fullparse)) {
+			converter->setError("Error: " + infile.getParseError());
+		} else {
+			converter->converter.setErrorStream(&converter->diagnostics);
+			status = converter->converter.convert(converter->output, infile);
+			converter->converter.setErrorStream(NULL);
+		}
+	} catch (exception& error) {
+		converter->converter.setErrorStream(NULL);
+		converter->setError(string("Error: ") + error.what());
+		status = false;
+	} catch (...) {
+		converter->converter.setErrorStream(NULL);
+		converter->setError("Error: conversion failed");
+		status = false;
+	}
+
+	if (output) {
+		*output = converter->output.getText().c_str();
+	}
+	if (outputsize) {
+		*outputsize = converter->output.getText().size();
+	}
+	return status ? 1 : 0;
+}
+
+
+
+//////////////////////////////
+//
+// hum2ly_get_diagnostics --
+//
+
+const char* hum2ly_get_diagnostics(hum2ly_converter* converter,
+		size_t* size) {
+	if (converter == NULL) {
+		if (size) {
+			*size = 0;
+		}
+		return "";
+	}
+	converter->diagnostictext = converter->diagnostics.str();
+	if (size) {
+		*size = converter->diagnostictext.size();
+	}
+	return converter->diagnostictext.c_str();
+}
+
+
+
+//////////////////////////////
+//
+// hum2ly_get_version --
+//
+
+const char* hum2ly_get_version(void) {
+	return HumdrumToLilypondConverter::getConverterVersion();
+}
+
+
+
@@ -0,0 +1,83 @@
+//
+// Programmer:    Craig Stuart Sapp <craig@ccrma.stanford.edu>
+// Creation Date: Sat Oct 17 16:40:05 CEST 2026
+// Last Modified: Sat Oct 17 16:40:05 CEST 2026
+// Filename:      hum2lyc.h
+// URL:           https://github.com/craigsapp/hum2ly/blob/master/hum2lyc.h
+// Syntax:        C99 or C++11
+// vim:           ts=3 noexpandtab
+//
+// Description:   C interface to libhum2ly for converting Humdrum data into
+//                lilypond data inside of another program:
+//
+//                   hum2ly_converter* converter = hum2ly_create();
+//                   const char* output;
+//                   size_t size;
+//                   if (!hum2ly_convert(converter, data, datasize,
+//                         &output, &size)) {
+//                      fputs(hum2ly_get_diagnostics(converter, NULL), stderr);
+//                   }
+//                   fwrite(output, 1, size, stdout);
+//                   hum2ly_destroy(converter);
+//
+//                A converter keeps its buffers between conversions, so it
+//                should be reused for many conversions.  A converter may
+//                only be used by one thread at a time, but any number of
+//                converters can be used in parallel.
+//
+
+#ifndef _HUM2LYC_H
+#define _HUM2LYC_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct hum2ly_converter hum2ly_converter;
+
+
+// Create a converter with the default options.  Returns NULL if there
+// is not enough memory.
+hum2ly_converter* hum2ly_create(void);
+
+// Free a converter and its buffers.
+void hum2ly_destroy(hum2ly_converter* converter);
+
+// Set the conversion options with the same arguments as the hum2ly
+// program (without the program name), such as { "-k", "-t", "4" }.
+// Options which are not given are reset to their defaults, and options
+// which are not recognized are ignored.  Returns 0 (and sets the
+// diagnostics) if the options could not be set.
+int hum2ly_set_options(hum2ly_converter* converter, int argc,
+		const char* const* argv);
+
+// Convert size bytes of Humdrum data into lilypond data.  The output is
+// owned by the converter and stays valid until the next call with the
+// converter.  Returns 1 if the conversion succeeded and 0 if it failed,
+// and in both cases the messages are available from
+// hum2ly_get_diagnostics().
+int hum2ly_convert(hum2ly_converter* converter, const char* input,
+		size_t size, const char** output, size_t* outputsize);
+
+// Return the error messages of the last call (a null-terminated string,
+// empty if there were no errors).  If size is not NULL, it is set to the
+// length of the messages.
+const char* hum2ly_get_diagnostics(hum2ly_converter* converter,
+		size_t* size);
+
+// Return the converter version, which changes whenever the output of
+// the converter changes.
+const char* hum2ly_get_version(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* _HUM2LYC_H */
+
+
+
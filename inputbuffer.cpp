@@ -0,0 +1,153 @@
+//
+// Programmer:    Craig Stuart Sapp <craig@ccrma.stanford.edu>
+// Creation Date: Fri Oct 16 16:25:51 CEST 2026
+// Last Modified: Fri Oct 16 16:25:51 CEST 2026
+// Filename:      inputbuffer.cpp
+// URL:           https://github.com/craigsapp/hum2ly/blob/master/inputbuffer.cpp
+// Syntax:        C++11
+// vim:           ts=3 noexpandtab
+//
+// Description:   Memory-mapped (or bulk-read) input data which can be
+//                parsed through an istream without copying.
+//
+
+#include "inputbuffer.h"
+
+#include <cerrno>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace hum {
+
+
+//////////////////////////////
+//
+// InputBuffer::InputBuffer -- Constructor.
+//
+
+InputBuffer::InputBuffer(void) : m_stream(&m_streambuf) {
+	m_data   = NULL;
+	m_size   = 0;
+	m_mapped = false;
+	setData("", 0);
+}
+
+
+
+//////////////////////////////
+//
+// InputBuffer::clear -- Release the input data.
+//
+
+void InputBuffer::clear(void) {
+	if (m_mapped && (m_size > 0)) {
+		munmap(const_cast<char*>(m_data), m_size);
+	}
+	m_mapped = false;
+	m_buffer.clear();
+	setData("", 0);
+}
+
+
+
+//////////////////////////////
+//
+// InputBuffer::open -- Map a file into memory, or read it in one piece
+//    if it cannot be mapped.  Returns false if the file cannot be read.
+//
+
+bool InputBuffer::open(const string& filename) {
+	clear();
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+
+	struct stat info;
+	if ((fstat(fd, &info) == 0) && S_ISREG(info.st_mode) && (info.st_size > 0)) {
+		void* mapping = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE,
+				fd, 0);
+		if (mapping != MAP_FAILED) {
+			madvise(mapping, (size_t)info.st_size, MADV_SEQUENTIAL);
+			close(fd);
+			m_mapped = true;
+			setData((const char*)mapping, (size_t)info.st_size);
+			return true;
+		}
+	}
+
+	bool status = readAll(fd);
+	close(fd);
+	return status;
+}
+
+
+
+//////////////////////////////
+//
+// InputBuffer::readStdin -- Read all of standard input.
+//
+
+bool InputBuffer::readStdin(void) {
+	clear();
+	return readAll(0);
+}
+
+
+
+//////////////////////////////
+//
+// InputBuffer::readAll -- Read from a file descriptor until the end of
+//    the input, using large reads.
+//
+
+bool InputBuffer::readAll(int fd) {
+	const size_t chunk = 1 << 16;
+	size_t count = 0;
+	m_buffer.clear();
+	while (true) {
+		m_buffer.resize(count + chunk);
+		ssize_t status = read(fd, &m_buffer[count], chunk);
+		if (status < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			m_buffer.clear();
+			setData("", 0);
+			return false;
+		}
+		if (status == 0) {
+			break;
+		}
+		count += status;
+	}
+	m_buffer.resize(count);
+	setData(m_buffer.data(), m_buffer.size());
+	return true;
+}
+
+
+
+//////////////////////////////
+//
+// InputBuffer::setData -- Point the input stream at new data.
+//
+
+void InputBuffer::setData(const char* data, size_t size) {
+	m_data = data;
+	m_size = size;
+	m_streambuf.setData(data, size);
+	m_stream.clear();
+}
+
+
+
+}  // end of namespace hum
+
+
+
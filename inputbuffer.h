@@ -0,0 +1,111 @@
+//
+// Programmer:    Craig Stuart Sapp <craig@ccrma.stanford.edu>
+// Creation Date: Fri Oct 16 16:25:51 CEST 2026
+// Last Modified: Fri Oct 16 16:25:51 CEST 2026
+// Filename:      inputbuffer.h
+// URL:           https://github.com/craigsapp/hum2ly/blob/master/inputbuffer.h
+// Syntax:        C++11
+// vim:           ts=3 noexpandtab
+//
+// Description:   Memory-mapped (or bulk-read) input data which can be
+//                parsed through an istream without copying.
+//
+
+#ifndef _INPUTBUFFER_H
+#define _INPUTBUFFER_H
+
+#include <istream>
+#include <streambuf>
+#include <string>
+
+namespace hum {
+
+using namespace std;
+
+
+//////////////////////////////
+//
+// MemoryStreambuf -- Read-only stream buffer over a block of memory.
+//    Seeking is supported so that the data can be read a second time.
+//
+
+class MemoryStreambuf : public streambuf {
+	public:
+		MemoryStreambuf(void) {}
+		~MemoryStreambuf() {}
+		void setData(const char* data, size_t size) {
+			char* start = const_cast<char*>(data);
+			setg(start, start, start + size);
+		}
+
+	protected:
+		pos_type seekoff(off_type offset, ios_base::seekdir direction,
+				ios_base::openmode which = ios_base::in) override {
+			char* position = gptr() + offset;
+			if (direction == ios_base::beg) {
+				position = eback() + offset;
+			} else if (direction == ios_base::end) {
+				position = egptr() + offset;
+			}
+			if (!(which & ios_base::in) || (position < eback()) ||
+					(position > egptr())) {
+				return pos_type(off_type(-1));
+			}
+			setg(eback(), position, egptr());
+			return pos_type(off_type(position - eback()));
+		}
+
+		pos_type seekpos(pos_type position,
+				ios_base::openmode which = ios_base::in) override {
+			return seekoff(off_type(position), ios_base::beg, which);
+		}
+};
+
+
+
+//////////////////////////////
+//
+// InputBuffer -- The contents of an input file.  Regular files are
+//    memory-mapped, and anything which cannot be mapped (such as pipes
+//    or standard input) is read in a single bulk read.  The data is
+//    available through getStream() without any intermediate copies.
+//
+
+class InputBuffer {
+	public:
+		InputBuffer(void);
+		~InputBuffer() { clear(); }
+
+		bool         open       (const string& filename);
+		bool         readStdin  (void);
+		void         clear      (void);
+		const char*  getData    (void) const { return m_data; }
+		size_t       getSize    (void) const { return m_size; }
+		bool         isMapped   (void) const { return m_mapped; }
+		istream&     getStream  (void) { return m_stream; }
+
+	protected:
+		bool         readAll    (int fd);
+		void         setData    (const char* data, size_t size);
+
+	private:
+		// Not copyable since it owns the mapping:
+		InputBuffer(const InputBuffer&);
+		InputBuffer& operator=(const InputBuffer&);
+
+		const char*      m_data;    // start of input data
+		size_t           m_size;    // number of bytes of input data
+		bool             m_mapped;  // true if m_data is memory-mapped
+		string           m_buffer;  // storage for data which is not mapped
+		MemoryStreambuf  m_streambuf;
+		istream          m_stream;
+};
+
+
+}  // end of namespace hum
+
+
+#endif /* _INPUTBUFFER_H */
+
+
+
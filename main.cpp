@@ -1,46 +1,617 @@
 //
 // Programmer:    Craig Stuart Sapp <craig@ccrma.stanford.edu>
 // Creation Date: Sat Aug  6 10:53:40 CEST 2016
-// Last Modified: Tue Aug  9 12:53:15 CEST 2016
+// Last Modified: Fri Oct 16 09:12:08 CEST 2026
 // Filename:      main.cpp
 // URL:           https://github.com/craigsapp/hum2ly/blob/master/main.cpp
 // Syntax:        C++11
 // vim:           ts=3 noexpandtab
 //
-// Description:   Command-line interface for converting Humdrum files into 
+// Description:   Command-line interface for converting Humdrum files into
 //                lilypond files.
 //
 
+#include "config.h"
+#include "diskcache.h"
 #include "hum2ly.h"
+#include "inputbuffer.h"
+#include "profiler.h"
+#include "server.h"
+#include "statistics.h"
+#include "taskpool.h"
 
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <fstream>
 #include <iostream>
+#include <memory>
+#include <sstream>
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
 
 using namespace std;
 
+// batch-mode input file and its conversion results:
+class BatchJob {
+	public:
+		string  input;    // Humdrum input filename
+		string  output;   // lilypond output filename
+		size_t  bytes;    // size of input file
+		bool    status;   // true if conversion was successful
+		string  message;  // description of problem if status is false
+		hum::ConversionStatistics statistics; // counts for the file
+};
+
+// settings shared by all batch-mode conversions:
+class BatchSettings {
+	public:
+		hum::Profiler*  profiler;   // phase timers (NULL = not profiling)
+		bool            statsfile;  // write a .stats.json file for each output
+		hum::DiskCache* cache;      // conversion cache (NULL = no cache)
+};
+
+// function declarations:
+int    convertSingleFile (hum::Options& options, hum::Profiler* profiler);
+int    convertBatch      (hum::Options& options, hum::Profiler* profiler);
+int    runClient         (hum::Options& options);
+void   addBatchInput     (vector<BatchJob>& jobs, const string& path,
+                          const string& outdir);
+void   addBatchDirectory (vector<BatchJob>& jobs, const string& directory,
+                          const string& relative, const string& outdir);
+void   addBatchFile      (vector<BatchJob>& jobs, const string& filename,
+                          const string& relative, const string& outdir);
+string getOutputFilename (const string& relative, const string& outdir);
+bool   makeDirectories   (const string& path);
+void   convertBatchJob   (BatchJob& job,
+                          hum::HumdrumToLilypondConverter& converter,
+                          const BatchSettings& settings);
+bool   hasKernExtension  (const string& filename);
+bool   readInputFile     (hum::HumdrumFile& infile, hum::InputBuffer& input,
+                          const string& filename, bool fullparse);
+bool   writeProfile      (hum::Options& options, hum::Profiler& profiler);
+bool   writeStatistics   (const hum::ConversionStatistics& statistics,
+                          const string& filename);
+void   writeStatisticsFile(BatchJob& job, const BatchSettings& settings);
+
+
 int main(int argc, char** argv) {
-	hum::HumdrumToLilypondConverter converter;
-	hum::Options options = converter.getOptionDefinitions();
+	hum::Options options =
+			hum::HumdrumToLilypondConverter::getOptionDefinitions();
+	options.define("batch=b", "convert multiple files: arguments are files "
+			"or directories, or a list of files on stdin");
+	options.define("j|jobs=i:0", "number of threads for batch mode (0 = all cores)");
+	options.define("o|output-dir=s", "output directory for batch mode");
+	options.define("serve=s", "run a conversion server on this Unix socket");
+	options.define("client=s", "send files to the server on this Unix socket");
+	options.define("profile=s", "write a Chrome trace of the conversion "
+			"phases to this file, and a summary to stderr");
+	options.define("stats=b", "print conversion statistics as JSON to stderr "
+			"(totals in batch mode, with a .stats.json file for each output)");
+	options.define("source-map=s", "write a map from lilypond output offsets "
+			"to Humdrum lines and fields to this file");
+	options.define("cache-dir=s", "directory for caching batch conversions");
+	options.define("cache-size=i:1024", "size limit of cache directory in MB");
 	options.process(argc, argv);
 
+	if (options.getBoolean("serve")) {
+		hum::ConversionServer server(
+				hum::HumdrumToLilypondConverter::getOptionDefinitions(),
+				options.getInteger("jobs"));
+		exit(server.run(options.getString("serve")));
+	}
+	if (options.getBoolean("client")) {
+		exit(runClient(options));
+	}
+
+	hum::Profiler profiler;
+	hum::Profiler* profile = NULL;
+	if (options.getBoolean("profile")) {
+#ifdef HUM2LY_PROFILE
+		profile = &profiler;
+#else
+		cerr << "Warning: hum2ly was compiled without profiling support "
+		     << "(HUM2LY_PROFILE)" << endl;
+#endif
+	}
+
+	int status;
+	if (options.getBoolean("batch")) {
+		status = convertBatch(options, profile);
+	} else {
+		status = convertSingleFile(options, profile);
+	}
+	if (profile && !writeProfile(options, profiler)) {
+		status = 1;
+	}
+	exit(status);
+}
+
+
+
+//////////////////////////////
+//
+// convertSingleFile -- Convert one file (or standard input) and print the
+//    results to standard output.
+//
+
+int convertSingleFile(hum::Options& options, hum::Profiler* profiler) {
+	hum::HumdrumToLilypondConverter converter;
+	converter.setConfig(hum::ConversionConfig::fromOptions(options));
+	const hum::ConversionConfig& config = converter.getConfig();
+
 	hum::HumdrumFile infile;
+	hum::InputBuffer input;
 	string filename;
-	if (options.getArgCount() == 0) {
-		filename = "<STDIN>";
-		infile.read(cin);
-	} else {
-		filename = options.getArg(1);
-		infile.read(filename);
+	{
+		HUM2LY_PROFILE_SCOPE(profiler, "parse");
+		if (options.getArgCount() == 0) {
+			filename = "<STDIN>";
+			input.readStdin();
+			hum::HumdrumToLilypondConverter::readInput(infile,
+					input.getStream(), config.fullparse);
+		} else {
+			filename = options.getArg(1);
+			readInputFile(infile, input, filename, config.fullparse);
+		}
 	}
 
-	converter.setOptions(argc, argv);
-	stringstream out;
-	bool status = converter.convert(out, infile);
+	converter.setProfiler(profiler);
+	ofstream mapfile;
+	if (options.getBoolean("source-map")) {
+		mapfile.open(options.getString("source-map").c_str());
+		if (!mapfile.is_open()) {
+			cerr << "Error: cannot write " << options.getString("source-map")
+			     << endl;
+			return 1;
+		}
+		converter.setSourceMapStream(&mapfile);
+	}
+	bool status = converter.convert(cout, infile);
+	if (options.getBoolean("stats")) {
+		converter.getStatistics().writeJson(cerr);
+	}
 	if (!status) {
 		cerr << "Error converting file: " << filename << endl;
 	}
-	cout << out.str();
 
-	exit(0);
+	return 0;
+}
+
+
+
+//////////////////////////////
+//
+// runClient -- Send the input files (or standard input) to a conversion
+//    server, passing along the conversion options.
+//
+
+int runClient(hum::Options& options) {
+	vector<string> args;
+	if (options.getString("version") != "") {
+		args.push_back("-v");
+		args.push_back(options.getString("version"));
+	}
+	if (options.getBoolean("kern")) {
+		args.push_back("-k");
+	}
+
+	vector<string> files;
+	for (int i=1; i<=options.getArgCount(); i++) {
+		files.push_back(options.getArg(i));
+	}
+
+	return hum::runConversionClient(options.getString("client"), args, files);
+}
+
+
+
+//////////////////////////////
+//
+// convertBatch -- Convert a list of files in parallel, writing each result
+//    into its own .ly file.  The status of each file is printed to standard
+//    output (in input order) and a throughput report is printed to
+//    standard error.  Returns 1 if any file failed to convert.
+//
+
+int convertBatch(hum::Options& options, hum::Profiler* profiler) {
+	string outdir = options.getString("output-dir");
+	vector<BatchJob> jobs;
+
+	if (options.getArgCount() == 0) {
+		// read a manifest of filenames from standard input
+		string line;
+		while (getline(cin, line)) {
+			if (line.empty() || (line[0] == '#')) {
+				continue;
+			}
+			addBatchInput(jobs, line, outdir);
+		}
+	} else {
+		for (int i=1; i<=options.getArgCount(); i++) {
+			addBatchInput(jobs, options.getArg(i), outdir);
+		}
+	}
+
+	hum::TaskPool pool(options.getInteger("jobs"));
+	auto starttime = chrono::steady_clock::now();
+
+	// One converter for each worker thread, reused for all of the
+	// files that the worker converts.  The converters share one config.
+	shared_ptr<const hum::ConversionConfig> config =
+			hum::ConversionConfig::fromOptions(options);
+	vector<hum::HumdrumToLilypondConverter> converters(max(1,
+			min(pool.getThreadCount(), (int)jobs.size())));
+	for (int i=0; i<(int)converters.size(); i++) {
+		converters[i].setConfig(config);
+		converters[i].setProfiler(profiler);
+	}
+
+	unique_ptr<hum::DiskCache> cache;
+	if (options.getBoolean("cache-dir")) {
+		string cachedir = options.getString("cache-dir");
+		if (!makeDirectories(cachedir)) {
+			cerr << "Error: cannot create cache directory " << cachedir << endl;
+			return 1;
+		}
+		cache.reset(new hum::DiskCache(cachedir,
+				options.getInteger("cache-size") * 1048576L));
+	}
+
+	BatchSettings settings;
+	settings.profiler  = profiler;
+	settings.statsfile = options.getBoolean("stats");
+	settings.cache     = cache.get();
+
+	hum::ConversionStatistics totals;
+	int failures = 0;
+	pool.run((int)jobs.size(),
+		[&](int task, int worker) {
+			convertBatchJob(jobs[task], converters[worker], settings);
+		},
+		[&](int task) {
+			BatchJob& job = jobs[task];
+			totals.add(job.statistics);
+			if (job.status) {
+				cout << "ok\t" << job.input << "\t" << job.output << "\n";
+			} else {
+				failures++;
+				cout << "error\t" << job.input << "\t" << job.message << "\n";
+			}
+		});
+	cout.flush();
+
+	auto endtime = chrono::steady_clock::now();
+	double seconds = chrono::duration<double>(endtime - starttime).count();
+	double megabytes = 0.0;
+	for (int i=0; i<(int)jobs.size(); i++) {
+		megabytes += jobs[i].bytes / 1048576.0;
+	}
+	if (seconds <= 0.0) {
+		seconds = 1.0e-9;
+	}
+
+	cerr << "hum2ly: " << jobs.size() << " files (" << failures
+	     << " failed) in " << seconds << " sec using "
+	     << min(pool.getThreadCount(), max((int)jobs.size(), 1))
+	     << " threads: " << jobs.size() / seconds << " files/s, "
+	     << megabytes / seconds << " MB/s" << endl;
+	if (cache) {
+		cache->evict();
+		cache->printStatistics(cerr);
+	}
+	if (settings.statsfile) {
+		totals.writeJson(cerr);
+	}
+
+	return failures ? 1 : 0;
+}
+
+
+
+//////////////////////////////
+//
+// convertBatchJob -- Convert a single batch file.  If there is a cache
+//    entry for the input data (and converter options), it is copied to
+//    the output without parsing or converting the input, and the
+//    statistics which were stored with it are used.
+//
+
+void convertBatchJob(BatchJob& job,
+		hum::HumdrumToLilypondConverter& converter,
+		const BatchSettings& settings) {
+	hum::HumdrumFile infile;
+	hum::InputBuffer input;
+	bool opened = input.open(job.input);
+
+	size_t slash = job.output.rfind('/');
+	if ((slash != string::npos) && (slash > 0)) {
+		makeDirectories(job.output.substr(0, slash));
+	}
+
+	string key;
+	if (settings.cache && opened) {
+		key = hum::DiskCache::getKey(input.getData(), input.getSize(),
+				string(converter.getConverterVersion()) + "\n" +
+				converter.getOptionsKey());
+		string statistics;
+		if (settings.cache->fetch(key, job.output, statistics) &&
+				job.statistics.readJson(statistics)) {
+			job.status = true;
+			writeStatisticsFile(job, settings);
+			return;
+		}
+	}
+
+	bool readstatus;
+	{
+		HUM2LY_PROFILE_SCOPE(settings.profiler, "parse");
+		bool fullparse = converter.getConfig().fullparse;
+		if (opened) {
+			readstatus = hum::HumdrumToLilypondConverter::readInput(infile,
+					input.getStream(), fullparse);
+		} else {
+			readstatus = hum::HumdrumToLilypondConverter::readInput(infile,
+					job.input, fullparse);
+		}
+	}
+	if (!readstatus) {
+		job.status = false;
+		job.message = "cannot read or parse input";
+		return;
+	}
+
+	ofstream outfile(job.output.c_str());
+	if (!outfile.is_open()) {
+		job.status = false;
+		job.message = "cannot write " + job.output;
+		return;
+	}
+
+	job.status = converter.convert(outfile, infile);
+	job.statistics = converter.getStatistics();
+	if (!job.status) {
+		job.message = "conversion error";
+	}
+
+	outfile.close();
+	if (!outfile) {
+		job.status = false;
+		job.message = "cannot write " + job.output;
+		return;
+	}
+
+	writeStatisticsFile(job, settings);
+
+	if (job.status && !key.empty()) {
+		// Failed conversions are not cached so that they are retried.
+		stringstream statistics;
+		job.statistics.writeJson(statistics);
+		settings.cache->store(key, job.output, statistics.str());
+	}
+}
+
+
+
+//////////////////////////////
+//
+// writeStatisticsFile -- Write the .stats.json file for a batch file
+//    if requested.
+//
+
+void writeStatisticsFile(BatchJob& job, const BatchSettings& settings) {
+	if (!settings.statsfile) {
+		return;
+	}
+	// foo.ly -> foo.stats.json
+	string filename = job.output.substr(0, job.output.size() - 3) +
+			".stats.json";
+	if (!writeStatistics(job.statistics, filename)) {
+		job.status = false;
+		job.message = "cannot write " + filename;
+	}
+}
+
+
+
+//////////////////////////////
+//
+// addBatchInput -- Add a file, or all **kern files found in a
+//    directory, to the list of files to convert.
+//
+
+void addBatchInput(vector<BatchJob>& jobs, const string& path,
+		const string& outdir) {
+	struct stat info;
+	if ((stat(path.c_str(), &info) == 0) && S_ISDIR(info.st_mode)) {
+		addBatchDirectory(jobs, path, "", outdir);
+		return;
+	}
+	size_t slash = path.rfind('/');
+	string relative = (slash == string::npos) ? path : path.substr(slash + 1);
+	addBatchFile(jobs, path, relative, outdir);
+}
+
+
+
+//////////////////////////////
+//
+// addBatchDirectory -- Recursively add all *.krn files in a directory.
+//    Files are added in sorted order so that results are reproducible.
+//
+
+void addBatchDirectory(vector<BatchJob>& jobs, const string& directory,
+		const string& relative, const string& outdir) {
+	DIR* dir = opendir(directory.c_str());
+	if (dir == NULL) {
+		BatchJob job;
+		job.input = directory;
+		job.bytes = 0;
+		job.status = false;
+		job.message = "cannot open directory";
+		jobs.push_back(job);
+		return;
+	}
+
+	vector<string> names;
+	struct dirent* entry;
+	while ((entry = readdir(dir)) != NULL) {
+		string name = entry->d_name;
+		if ((name == ".") || (name == "..")) {
+			continue;
+		}
+		names.push_back(name);
+	}
+	closedir(dir);
+	sort(names.begin(), names.end());
+
+	struct stat info;
+	for (int i=0; i<(int)names.size(); i++) {
+		string path = directory + "/" + names[i];
+		string subrelative = relative.empty() ? names[i] : relative + "/" + names[i];
+		if (stat(path.c_str(), &info) != 0) {
+			continue;
+		}
+		if (S_ISDIR(info.st_mode)) {
+			addBatchDirectory(jobs, path, subrelative, outdir);
+		} else if (hasKernExtension(names[i])) {
+			addBatchFile(jobs, path, subrelative, outdir);
+		}
+	}
+}
+
+
+
+//////////////////////////////
+//
+// addBatchFile --
+//
+
+void addBatchFile(vector<BatchJob>& jobs, const string& filename,
+		const string& relative, const string& outdir) {
+	BatchJob job;
+	job.input = filename;
+	job.status = false;
+	struct stat info;
+	job.bytes = (stat(filename.c_str(), &info) == 0) ? (size_t)info.st_size : 0;
+	if (outdir.empty()) {
+		job.output = getOutputFilename(filename, "");
+	} else {
+		job.output = getOutputFilename(relative, outdir);
+	}
+	jobs.push_back(job);
+}
+
+
+
+//////////////////////////////
+//
+// getOutputFilename -- Replace the input filename's extension with ".ly"
+//    and place it in the output directory if one is given.
+//
+
+string getOutputFilename(const string& relative, const string& outdir) {
+	string output = relative;
+	size_t slash = output.rfind('/');
+	size_t dot = output.rfind('.');
+	if ((dot != string::npos) && ((slash == string::npos) || (dot > slash))) {
+		output.resize(dot);
+	}
+	output += ".ly";
+	if (!outdir.empty()) {
+		output = outdir + "/" + output;
+	}
+	return output;
+}
+
+
+
+//////////////////////////////
+//
+// makeDirectories -- Create a directory and any missing parent
+//    directories.
+//
+
+bool makeDirectories(const string& path) {
+	struct stat info;
+	if (stat(path.c_str(), &info) == 0) {
+		return S_ISDIR(info.st_mode);
+	}
+	size_t slash = path.rfind('/');
+	if ((slash != string::npos) && (slash > 0)) {
+		makeDirectories(path.substr(0, slash));
+	}
+	// Another thread may have created the directory in the meantime.
+	return (mkdir(path.c_str(), 0777) == 0) || (errno == EEXIST);
+}
+
+
+
+//////////////////////////////
+//
+// hasKernExtension --
+//
+
+bool hasKernExtension(const string& filename) {
+	size_t len = filename.size();
+	return (len > 4) && (filename.compare(len - 4, 4, ".krn") == 0);
+}
+
+
+
+//////////////////////////////
+//
+// readInputFile -- Parse a Humdrum file directly from memory-mapped (or
+//    bulk-read) data.  Names which cannot be opened as files are passed
+//    to humlib, which reports the error (or handles other input sources).
+//
+
+bool readInputFile(hum::HumdrumFile& infile, hum::InputBuffer& input,
+		const string& filename, bool fullparse) {
+	if (!input.open(filename)) {
+		return hum::HumdrumToLilypondConverter::readInput(infile, filename,
+				fullparse);
+	}
+	return hum::HumdrumToLilypondConverter::readInput(infile,
+			input.getStream(), fullparse);
+}
+
+
+
+//////////////////////////////
+//
+// writeProfile -- Save the profiling spans as a Chrome trace-event file
+//    and print a one-line summary to standard error.
+//
+
+bool writeProfile(hum::Options& options, hum::Profiler& profiler) {
+	profiler.printSummary(cerr);
+	string filename = options.getString("profile");
+	ofstream outfile(filename.c_str());
+	profiler.writeTrace(outfile);
+	outfile.close();
+	if (!outfile) {
+		cerr << "Error: cannot write profile " << filename << endl;
+		return false;
+	}
+	return true;
+}
+
+
+
+//////////////////////////////
+//
+// writeStatistics -- Save the statistics for a file as JSON.
+//
+
+bool writeStatistics(const hum::ConversionStatistics& statistics,
+		const string& filename) {
+	ofstream outfile(filename.c_str());
+	statistics.writeJson(outfile);
+	outfile.close();
+	return !outfile.fail();
 }
 
 
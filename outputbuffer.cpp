@@ -0,0 +1,171 @@
+//
+// Programmer:    Craig Stuart Sapp <craig@ccrma.stanford.edu>
+// Creation Date: Sat Oct 17 16:22:09 CEST 2026
+// Last Modified: Sat Oct 17 16:22:09 CEST 2026
+// Filename:      outputbuffer.cpp
+// URL:           https://github.com/craigsapp/hum2ly/blob/master/outputbuffer.cpp
+// Syntax:        C++11
+// vim:           ts=3 noexpandtab
+//
+// Description:   Append-only output buffer for writing lilypond data.
+//
+
+#include "outputbuffer.h"
+
+#include <cerrno>
+
+#include <unistd.h>
+
+using namespace std;
+
+namespace hum {
+
+
+//////////////////////////////
+//
+// OutputBuffer::OutputBuffer -- Constructors.  Without a target, the
+//    buffer is never written out.
+//
+
+OutputBuffer::OutputBuffer(void) {
+	m_blocksize = (size_t)-1;
+	m_flushed   = 0;
+	m_out       = NULL;
+	m_fd        = -1;
+	m_failed    = false;
+}
+
+
+OutputBuffer::OutputBuffer(ostream& out, size_t blocksize) {
+	m_blocksize = blocksize;
+	m_flushed   = 0;
+	m_out       = &out;
+	m_fd        = -1;
+	m_failed    = false;
+	m_buffer.reserve(blocksize + 1024);
+}
+
+
+OutputBuffer::OutputBuffer(int fd, size_t blocksize) {
+	m_blocksize = blocksize;
+	m_flushed   = 0;
+	m_out       = NULL;
+	m_fd        = fd;
+	m_failed    = false;
+	m_buffer.reserve(blocksize + 1024);
+}
+
+
+
+//////////////////////////////
+//
+// OutputBuffer::operator<< -- Integers are formatted without the
+//    locale, and HumNums are printed as "n" or "n/d" (as they are by
+//    humlib).
+//
+
+OutputBuffer& OutputBuffer::operator<<(long value) {
+	char digits[24];
+	int count = 0;
+	unsigned long magnitude = value < 0 ? 0UL - (unsigned long)value :
+			(unsigned long)value;
+	do {
+		digits[count++] = '0' + (char)(magnitude % 10);
+		magnitude /= 10;
+	} while (magnitude > 0);
+	if (value < 0) {
+		digits[count++] = '-';
+	}
+	for (int i=count-1; i>=0; i--) {
+		m_buffer.push_back(digits[i]);
+	}
+	checkBlock();
+	return *this;
+}
+
+
+OutputBuffer& OutputBuffer::operator<<(const HumNum& value) {
+	*this << value.getNumerator();
+	if (value.getDenominator() != 1) {
+		*this << '/' << value.getDenominator();
+	}
+	return *this;
+}
+
+
+
+//////////////////////////////
+//
+// OutputBuffer::clear -- Remove the contents of an in-memory buffer,
+//    keeping its allocated memory.
+//
+
+void OutputBuffer::clear(void) {
+	m_buffer.clear();
+	m_flushed = 0;
+}
+
+
+
+//////////////////////////////
+//
+// OutputBuffer::flush -- Write any pending data to the target.
+//
+
+void OutputBuffer::flush(void) {
+	if ((m_out == NULL) && (m_fd < 0)) {
+		return;
+	}
+	writeBlock();
+	if (m_out) {
+		m_out->flush();
+		if (!*m_out) {
+			m_failed = true;
+		}
+	}
+}
+
+
+
+//////////////////////////////
+//
+// OutputBuffer::writeBlock --
+//
+
+void OutputBuffer::writeBlock(void) {
+	if (m_buffer.empty()) {
+		return;
+	}
+	if (m_out) {
+		m_out->write(m_buffer.data(), m_buffer.size());
+		if (!*m_out) {
+			m_failed = true;
+		}
+	} else if (m_fd >= 0) {
+		const char* data = m_buffer.data();
+		size_t remaining = m_buffer.size();
+		while (remaining > 0) {
+			ssize_t count = write(m_fd, data, remaining);
+			if (count < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				m_failed = true;
+				break;
+			}
+			data += count;
+			remaining -= count;
+		}
+	} else {
+		return;
+	}
+	m_flushed += m_buffer.size();
+	m_buffer.clear();
+}
+
+
+
+}  // end of namespace hum
+
+
+
@@ -0,0 +1,102 @@
+//
+// Programmer:    Craig Stuart Sapp <craig@ccrma.stanford.edu>
+// Creation Date: Sat Oct 17 16:22:09 CEST 2026
+// Last Modified: Sat Oct 17 16:22:09 CEST 2026
+// Filename:      outputbuffer.h
+// URL:           https://github.com/craigsapp/hum2ly/blob/master/outputbuffer.h
+// Syntax:        C++11
+// vim:           ts=3 noexpandtab
+//
+// Description:   Append-only output buffer for writing lilypond data.
+//
+
+#ifndef _OUTPUTBUFFER_H
+#define _OUTPUTBUFFER_H
+
+#include "humlib.h"
+
+#include <cstring>
+#include <ostream>
+#include <string>
+
+namespace hum {
+
+using namespace std;
+
+
+//////////////////////////////
+//
+// OutputBuffer -- Collects output in a string, and writes it to an
+//    ostream or file descriptor in large blocks.  Appending characters,
+//    strings and numbers does not go through the stream sentry and locale
+//    machinery of ostream::operator<<, and does not allocate memory once
+//    the buffer has grown to its block size.  A buffer without a target
+//    keeps all of its contents in memory (see getText()).
+//
+
+class OutputBuffer {
+	public:
+		OutputBuffer(void);
+		explicit OutputBuffer(ostream& out, size_t blocksize = 65536);
+		explicit OutputBuffer(int fd, size_t blocksize = 65536);
+		~OutputBuffer() { flush(); }
+
+		void          append       (const char* data, size_t size) {
+		                              m_buffer.append(data, size);
+		                              checkBlock();
+		                           }
+		OutputBuffer& operator<<   (char ch) {
+		                              m_buffer.push_back(ch);
+		                              checkBlock();
+		                              return *this;
+		                           }
+		OutputBuffer& operator<<   (const char* text) {
+		                              append(text, strlen(text));
+		                              return *this;
+		                           }
+		OutputBuffer& operator<<   (const string& text) {
+		                              append(text.data(), text.size());
+		                              return *this;
+		                           }
+		OutputBuffer& operator<<   (int value) {
+		                              return *this << (long)value;
+		                           }
+		OutputBuffer& operator<<   (long value);
+		OutputBuffer& operator<<   (const HumNum& value);
+
+		size_t        getOffset    (void) const
+		                              { return m_flushed + m_buffer.size(); }
+		const string& getText      (void) const { return m_buffer; }
+		void          clear        (void);
+		void          flush        (void);
+		bool          fail         (void) const { return m_failed; }
+
+	protected:
+		void          checkBlock   (void) {
+		                              if (m_buffer.size() >= m_blocksize) {
+		                                 writeBlock();
+		                              }
+		                           }
+		void          writeBlock   (void);
+
+	private:
+		// Not copyable since it refers to its target:
+		OutputBuffer(const OutputBuffer&);
+		OutputBuffer& operator=(const OutputBuffer&);
+
+		string    m_buffer;     // data not yet written to the target
+		size_t    m_blocksize;  // write to the target at this size
+		size_t    m_flushed;    // bytes written to the target
+		ostream*  m_out;        // target stream (or NULL)
+		int       m_fd;         // target file descriptor (or -1)
+		bool      m_failed;     // true if writing to the target failed
+};
+
+
+}  // end of namespace hum
+
+
+#endif /* _OUTPUTBUFFER_H */
+
+
+
@@ -0,0 +1,193 @@
+//
+// Programmer:    Craig Stuart Sapp <craig@ccrma.stanford.edu>
+// Creation Date: Fri Oct 16 20:10:33 CEST 2026
+// Last Modified: Fri Oct 16 20:10:33 CEST 2026
+// Filename:      profiler.cpp
+// URL:           https://github.com/craigsapp/hum2ly/blob/master/profiler.cpp
+// Syntax:        C++11
+// vim:           ts=3 noexpandtab
+//
+// Description:   Scoped timers for the phases of a conversion, which can be
+//                saved as a Chrome trace-event file and summarized on one
+//                line.
+//
+
+#include "profiler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+
+using namespace std;
+
+namespace hum {
+
+
+//////////////////////////////
+//
+// Profiler::Profiler -- Constructor.  Times are measured from the
+//    creation of the profiler.
+//
+
+Profiler::Profiler(void) {
+	m_origin = chrono::steady_clock::now();
+}
+
+
+
+//////////////////////////////
+//
+// Profiler::clear -- Remove all spans.
+//
+
+void Profiler::clear(void) {
+	lock_guard<mutex> guard(m_lock);
+	m_spans.clear();
+}
+
+
+
+//////////////////////////////
+//
+// Profiler::getTime -- Microseconds since the profiler was created.
+//
+
+double Profiler::getTime(void) const {
+	return chrono::duration<double, micro>(chrono::steady_clock::now() -
+			m_origin).count();
+}
+
+
+
+//////////////////////////////
+//
+// Profiler::addSpan -- Store a finished span for the current thread.
+//
+
+void Profiler::addSpan(const char* name, double start, double end, int part,
+		int segment) {
+	Span span;
+	span.name     = name;
+	span.start    = start;
+	span.duration = end - start;
+	span.part     = part;
+	span.segment  = segment;
+
+	lock_guard<mutex> guard(m_lock);
+	span.thread = getThreadIndex();
+	m_spans.push_back(span);
+}
+
+
+
+//////////////////////////////
+//
+// Profiler::getThreadIndex -- Number the threads in order of their first
+//    span, which gives more readable trace output than thread ids.  Must
+//    be called with m_lock held.
+//
+
+int Profiler::getThreadIndex(void) {
+	thread::id id = this_thread::get_id();
+	for (int i=0; i<(int)m_threads.size(); i++) {
+		if (m_threads[i] == id) {
+			return i;
+		}
+	}
+	m_threads.push_back(id);
+	return (int)m_threads.size() - 1;
+}
+
+
+
+//////////////////////////////
+//
+// Profiler::writeTrace -- Write the spans in the Chrome trace-event
+//    format, which can be loaded into chrome://tracing or Perfetto.
+//
+
+void Profiler::writeTrace(ostream& out) {
+	lock_guard<mutex> guard(m_lock);
+	ios::fmtflags flags = out.flags();
+	streamsize precision = out.precision();
+	out << fixed << setprecision(3);
+	out << "{\"traceEvents\":[\n";
+	for (int i=0; i<(int)m_spans.size(); i++) {
+		Span& span = m_spans[i];
+		out << "{\"name\":\"" << span.name << "\",\"cat\":\"hum2ly\""
+		    << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << span.thread
+		    << ",\"ts\":" << span.start << ",\"dur\":" << span.duration;
+		if ((span.part >= 0) || (span.segment >= 0)) {
+			out << ",\"args\":{";
+			if (span.part >= 0) {
+				out << "\"part\":" << span.part;
+			}
+			if (span.segment >= 0) {
+				out << (span.part >= 0 ? "," : "") << "\"segment\":"
+				    << span.segment;
+			}
+			out << "}";
+		}
+		out << "}" << (i < (int)m_spans.size() - 1 ? "," : "") << "\n";
+	}
+	out << "],\"displayTimeUnit\":\"ms\"}\n";
+	out.flags(flags);
+	out.precision(precision);
+}
+
+
+
+//////////////////////////////
+//
+// Profiler::printSummary -- Print the wall time covered by the spans and
+//    the total time and count for each phase (in order of first use) on
+//    one line.  Phase times are summed over all threads.
+//
+
+void Profiler::printSummary(ostream& out) {
+	lock_guard<mutex> guard(m_lock);
+	vector<const char*> names;
+	vector<double> totals;
+	vector<int> counts;
+	double first = 0.0;
+	double last = 0.0;
+	for (int i=0; i<(int)m_spans.size(); i++) {
+		Span& span = m_spans[i];
+		if ((i == 0) || (span.start < first)) {
+			first = span.start;
+		}
+		last = max(last, span.start + span.duration);
+		int index = -1;
+		for (int j=0; j<(int)names.size(); j++) {
+			if (strcmp(names[j], span.name) == 0) {
+				index = j;
+				break;
+			}
+		}
+		if (index < 0) {
+			index = (int)names.size();
+			names.push_back(span.name);
+			totals.push_back(0.0);
+			counts.push_back(0);
+		}
+		totals[index] += span.duration;
+		counts[index]++;
+	}
+
+	out << "hum2ly profile: " << (last - first) / 1000.0 << " ms";
+	for (int i=0; i<(int)names.size(); i++) {
+		out << (i == 0 ? ": " : ", ") << names[i] << " "
+		    << totals[i] / 1000.0 << " ms";
+		if (counts[i] > 1) {
+			out << " (" << counts[i] << "x)";
+		}
+	}
+	out << endl;
+}
+
+
+
+}  // end of namespace hum
+
+
+
@@ -0,0 +1,117 @@
+//
+// Programmer:    Craig Stuart Sapp <craig@ccrma.stanford.edu>
+// Creation Date: Fri Oct 16 20:10:33 CEST 2026
+// Last Modified: Fri Oct 16 20:10:33 CEST 2026
+// Filename:      profiler.h
+// URL:           https://github.com/craigsapp/hum2ly/blob/master/profiler.h
+// Syntax:        C++11
+// vim:           ts=3 noexpandtab
+//
+// Description:   Scoped timers for the phases of a conversion, which can be
+//                saved as a Chrome trace-event file and summarized on one
+//                line.  Timers are placed with HUM2LY_PROFILE_SCOPE, which
+//                compiles to nothing unless HUM2LY_PROFILE is defined.
+//
+
+#ifndef _PROFILER_H
+#define _PROFILER_H
+
+#include <chrono>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace hum {
+
+using namespace std;
+
+
+//////////////////////////////
+//
+// Profiler -- Collects timed spans from any number of threads.
+//
+
+class Profiler {
+	public:
+		Profiler(void);
+		~Profiler() {}
+
+		void    clear          (void);
+		double  getTime        (void) const;
+		void    addSpan        (const char* name, double start, double end,
+		                        int part = -1, int segment = -1);
+		void    writeTrace     (ostream& out);
+		void    printSummary   (ostream& out);
+
+	protected:
+		int     getThreadIndex (void);
+
+	private:
+		struct Span {
+			const char* name;     // phase name (static string)
+			double      start;    // microseconds since profiler creation
+			double      duration; // microseconds
+			int         thread;   // small thread number
+			int         part;     // part index (-1 if not for a part)
+			int         segment;  // segment index (-1 if not for a segment)
+		};
+
+		chrono::steady_clock::time_point m_origin;
+		vector<Span>       m_spans;
+		vector<thread::id> m_threads;  // thread number -> thread id
+		mutex              m_lock;     // lock for m_spans and m_threads
+};
+
+
+
+//////////////////////////////
+//
+// ProfileScope -- Records a span from construction to destruction.  A
+//    NULL profiler disables the timer.
+//
+
+class ProfileScope {
+	public:
+		ProfileScope(Profiler* profiler, const char* name, int part = -1,
+				int segment = -1) {
+			m_profiler = profiler;
+			if (m_profiler) {
+				m_name    = name;
+				m_part    = part;
+				m_segment = segment;
+				m_start   = m_profiler->getTime();
+			}
+		}
+		~ProfileScope() {
+			if (m_profiler) {
+				m_profiler->addSpan(m_name, m_start, m_profiler->getTime(),
+						m_part, m_segment);
+			}
+		}
+
+	private:
+		Profiler*   m_profiler;
+		const char* m_name;
+		double      m_start;
+		int         m_part;
+		int         m_segment;
+};
+
+
+#ifdef HUM2LY_PROFILE
+	#define HUM2LY_PROFILE_SCOPE(...) \
+		hum::ProfileScope hum2ly_profilescope(__VA_ARGS__)
+#else
+	#define HUM2LY_PROFILE_SCOPE(...)
+#endif
+
+
+}  // end of namespace hum
+
+
+#endif /* _PROFILER_H */
+
+
+
@@ -0,0 +1,150 @@
+//
+// Programmer:    Craig Stuart Sapp <craig@ccrma.stanford.edu>
+// Creation Date: Sat Oct 17 09:14:51 CEST 2026
+// Last Modified: Sat Oct 17 09:14:51 CEST 2026
+// Filename:      segmentcache.cpp
+// URL:           https://github.com/craigsapp/hum2ly/blob/master/segmentcache.cpp
+// Syntax:        C++11
+// vim:           ts=3 noexpandtab
+//
+// Description:   In-memory cache of converted segment variables, so that
+//                reconverting an edited score only converts the segments
+//                which changed.
+//
+
+#include "segmentcache.h"
+
+using namespace std;
+
+namespace hum {
+
+
+//////////////////////////////
+//
+// SegmentCache::clear -- Remove all entries.
+//
+
+void SegmentCache::clear(void) {
+	lock_guard<mutex> guard(m_lock);
+	m_entries.clear();
+	m_recomputed.clear();
+}
+
+
+
+//////////////////////////////
+//
+// SegmentCache::startConversion -- Reset the list of recomputed
+//    segments for a new conversion.
+//
+
+void SegmentCache::startConversion(int partcount, int segmentcount) {
+	lock_guard<mutex> guard(m_lock);
+	m_generation++;
+	m_segmentcount = segmentcount;
+	m_recomputed.assign(partcount * segmentcount, 0);
+}
+
+
+
+//////////////////////////////
+//
+// SegmentCache::endConversion -- Remove the entries which were not used
+//    by the conversion (such as the old versions of edited segments).
+//
+
+void SegmentCache::endConversion(void) {
+	lock_guard<mutex> guard(m_lock);
+	for (auto it = m_entries.begin(); it != m_entries.end(); ) {
+		if (it->second.generation != m_generation) {
+			it = m_entries.erase(it);
+		} else {
+			it++;
+		}
+	}
+}
+
+
+
+//////////////////////////////
+//
+// SegmentCache::lookup -- Copy the entry for the key.  The entry is only
+//    used if its key text matches (the key is a hash of the key text).
+//    Error messages contain line numbers, so an entry with errors is only
+//    used if the segment has not moved in the file.  Returns false if
+//    there is no usable entry.
+//
+
+bool SegmentCache::lookup(uint64_t key, const string& keytext, int startline,
+		SegmentCacheEntry& entry) {
+	lock_guard<mutex> guard(m_lock);
+	auto it = m_entries.find(key);
+	if (it == m_entries.end()) {
+		return false;
+	}
+	if (it->second.keytext != keytext) {
+		return false;
+	}
+	if (!it->second.errors.empty() && (it->second.startline != startline)) {
+		return false;
+	}
+	it->second.generation = m_generation;
+	entry = it->second;
+	return true;
+}
+
+
+
+//////////////////////////////
+//
+// SegmentCache::store --
+//
+
+void SegmentCache::store(uint64_t key, const SegmentCacheEntry& entry) {
+	lock_guard<mutex> guard(m_lock);
+	SegmentCacheEntry& stored = m_entries[key];
+	stored = entry;
+	stored.generation = m_generation;
+}
+
+
+
+//////////////////////////////
+//
+// SegmentCache::markRecomputed -- Note that a segment was converted
+//    rather than taken from the cache.
+//
+
+void SegmentCache::markRecomputed(int part, int segment) {
+	lock_guard<mutex> guard(m_lock);
+	int index = part * m_segmentcount + segment;
+	if ((index >= 0) && (index < (int)m_recomputed.size())) {
+		m_recomputed[index] = 1;
+	}
+}
+
+
+
+//////////////////////////////
+//
+// SegmentCache::getRecomputedSegments -- Return the (part, segment)
+//    pairs which were converted in the last conversion.
+//
+
+vector<pair<int, int>> SegmentCache::getRecomputedSegments(void) {
+	lock_guard<mutex> guard(m_lock);
+	vector<pair<int, int>> output;
+	for (int i=0; i<(int)m_recomputed.size(); i++) {
+		if (m_recomputed[i]) {
+			output.push_back(make_pair(i / m_segmentcount, i % m_segmentcount));
+		}
+	}
+	return output;
+}
+
+
+
+}  // end of namespace hum
+
+
+
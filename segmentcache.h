@@ -0,0 +1,93 @@
+//
+// Programmer:    Craig Stuart Sapp <craig@ccrma.stanford.edu>
+// Creation Date: Sat Oct 17 09:14:51 CEST 2026
+// Last Modified: Sat Oct 17 09:14:51 CEST 2026
+// Filename:      segmentcache.h
+// URL:           https://github.com/craigsapp/hum2ly/blob/master/segmentcache.h
+// Syntax:        C++11
+// vim:           ts=3 noexpandtab
+//
+// Description:   In-memory cache of converted segment variables, so that
+//                reconverting an edited score only converts the segments
+//                which changed.
+//
+
+#ifndef _SEGMENTCACHE_H
+#define _SEGMENTCACHE_H
+
+#include "sourcemap.h"
+#include "statistics.h"
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace hum {
+
+using namespace std;
+
+
+//////////////////////////////
+//
+// SegmentCacheEntry -- The converted lilypond variable for one segment of
+//    one part, and everything else that converting it produced.
+//
+
+class SegmentCacheEntry {
+	public:
+		string         keytext;    // key material (checked on lookup)
+		string         text;       // lilypond variable
+		vector<string> errors;     // error messages for the segment
+		int            startline;  // line index of segment (for errors)
+		bool           status;     // result of convertSegmentVariable
+		ConversionStatistics statistics; // token counts for the segment
+		vector<SourceMapEntry> sourcemap; // offsets relative to text
+		int            generation; // last conversion which used the entry
+};
+
+
+
+//////////////////////////////
+//
+// SegmentCache -- Segment variables keyed by a hash of the segment's
+//    tokens and the options which affect their conversion.  The text
+//    which was hashed is stored with each entry, so a hash collision is
+//    a cache miss rather than the wrong segment.  Entries which
+//    are not used by a conversion are removed at the end of it, so the
+//    cache holds at most one score's segments.  The cache can be shared
+//    by the worker converters of a parallel conversion.
+//
+
+class SegmentCache {
+	public:
+		SegmentCache(void) { m_generation = 0; m_segmentcount = 1; }
+		~SegmentCache() {}
+
+		void   clear          (void);
+		void   startConversion(int partcount, int segmentcount);
+		void   endConversion  (void);
+		bool   lookup         (uint64_t key, const string& keytext,
+		                       int startline, SegmentCacheEntry& entry);
+		void   store          (uint64_t key, const SegmentCacheEntry& entry);
+		void   markRecomputed (int part, int segment);
+		vector<pair<int, int>> getRecomputedSegments(void);
+
+	private:
+		unordered_map<uint64_t, SegmentCacheEntry> m_entries;
+		vector<char> m_recomputed;  // flag for each part/segment
+		int          m_segmentcount;
+		int          m_generation;  // count of conversions
+		mutex        m_lock;
+};
+
+
+}  // end of namespace hum
+
+
+#endif /* _SEGMENTCACHE_H */
+
+
+
@@ -0,0 +1,696 @@
+//
+// Programmer:    Craig Stuart Sapp <craig@ccrma.stanford.edu>
+// Creation Date: Fri Oct 16 14:02:37 CEST 2026
+// Last Modified: Fri Oct 16 14:02:37 CEST 2026
+// Filename:      server.cpp
+// URL:           https://github.com/craigsapp/hum2ly/blob/master/server.cpp
+// Syntax:        C++11
+// vim:           ts=3 noexpandtab
+//
+// Description:   Conversion server which keeps warm converters and answers
+//                requests over a Unix domain socket, and a matching client.
+//
+
+#include "server.h"
+#include "taskpool.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace hum {
+
+// Set by SIGINT/SIGTERM to stop the server.  The signal handler also
+// writes to StopPipe, which wakes up the accept loop in poll() no matter
+// which thread the signal is delivered to:
+static volatile sig_atomic_t StopServer = 0;
+static int StopPipe[2] = { -1, -1 };
+
+static void   stopServerHandler (int signum);
+static double getPercentile     (const vector<double>& sorted, double fraction);
+static bool   getSocketAddress  (const string& socketpath,
+                                struct sockaddr_un& address);
+
+// Largest frame that will be accepted (to guard against garbage input).
+static const uint32_t MaxFrameSize = 0x40000000;
+
+// Number of recent request latencies kept for the percentiles:
+static const int MaxLatencies = 10000;
+
+
+
+//////////////////////////////
+//
+// readFrame -- Read a length-prefixed frame.  Returns false at the end
+//    of the connection or on an error.
+//
+
+bool readFrame(int fd, string& data) {
+	unsigned char header[4];
+	size_t count = 0;
+	while (count < 4) {
+		ssize_t status = read(fd, header + count, 4 - count);
+		if (status < 0 && errno == EINTR) {
+			continue;
+		}
+		if (status <= 0) {
+			return false;
+		}
+		count += status;
+	}
+	uint32_t size = ((uint32_t)header[0] << 24) | ((uint32_t)header[1] << 16) |
+			((uint32_t)header[2] << 8) | (uint32_t)header[3];
+	if (size > MaxFrameSize) {
+		return false;
+	}
+
+	data.resize(size);
+	count = 0;
+	while (count < size) {
+		ssize_t status = read(fd, &data[count], size - count);
+		if (status < 0 && errno == EINTR) {
+			continue;
+		}
+		if (status <= 0) {
+			return false;
+		}
+		count += status;
+	}
+	return true;
+}
+
+
+
+//////////////////////////////
+//
+// writeFrame -- Write a length-prefixed frame.
+//
+
+bool writeFrame(int fd, const string& data) {
+	if (data.size() > MaxFrameSize) {
+		return false;
+	}
+	uint32_t size = (uint32_t)data.size();
+	unsigned char header[4];
+	header[0] = (size >> 24) & 0xff;
+	header[1] = (size >> 16) & 0xff;
+	header[2] = (size >> 8) & 0xff;
+	header[3] = size & 0xff;
+
+	const char* buffers[2] = { (const char*)header, data.data() };
+	size_t sizes[2] = { 4, data.size() };
+	for (int i=0; i<2; i++) {
+		size_t count = 0;
+		while (count < sizes[i]) {
+			ssize_t status = write(fd, buffers[i] + count, sizes[i] - count);
+			if (status < 0 && errno == EINTR) {
+				continue;
+			}
+			if (status <= 0) {
+				return false;
+			}
+			count += status;
+		}
+	}
+	return true;
+}
+
+
+
+//////////////////////////////
+//
+// ConversionServer::ConversionServer -- The definitions are the
+//    converter's (unprocessed) option definitions, which are used to
+//    parse the options of each request.  A pool size of 0 means one
+//    converter for each hardware thread.
+//
+
+ConversionServer::ConversionServer(const Options& definitions, int poolsize) {
+	m_definitions = definitions;
+	m_requests = 0;
+	if (poolsize <= 0) {
+		poolsize = TaskPool::getHardwareThreadCount();
+	}
+	for (int i=0; i<poolsize; i++) {
+		m_converters.emplace_back(new HumdrumToLilypondConverter);
+		m_idle.push_back(m_converters.back().get());
+	}
+}
+
+
+
+//////////////////////////////
+//
+// ConversionServer::run -- Listen for clients until SIGINT or SIGTERM.
+//    When the server stops, the connections of clients which are still
+//    active are shut down, and run() waits for their threads to finish
+//    before returning.  The latency statistics are printed to standard
+//    error when the server stops.
+//
+
+int ConversionServer::run(const string& socketpath) {
+	struct sockaddr_un address;
+	if (!getSocketAddress(socketpath, address)) {
+		cerr << "Error: socket path too long: " << socketpath << endl;
+		return 1;
+	}
+
+	int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listener < 0) {
+		cerr << "Error: cannot create socket: " << strerror(errno) << endl;
+		return 1;
+	}
+	// Only replace an old socket: never delete a regular file (or
+	// anything else) which happens to have the socket's name.
+	struct stat info;
+	if (lstat(socketpath.c_str(), &info) == 0) {
+		if (!S_ISSOCK(info.st_mode)) {
+			cerr << "Error: " << socketpath << " exists and is not a socket"
+			     << endl;
+			close(listener);
+			return 1;
+		}
+		unlink(socketpath.c_str());
+	}
+	if (::bind(listener, (struct sockaddr*)&address, sizeof(address)) < 0) {
+		cerr << "Error: cannot bind " << socketpath << ": "
+		     << strerror(errno) << endl;
+		close(listener);
+		return 1;
+	}
+	if (listen(listener, 64) < 0) {
+		cerr << "Error: cannot listen on " << socketpath << ": "
+		     << strerror(errno) << endl;
+		close(listener);
+		return 1;
+	}
+	if (pipe(StopPipe) < 0) {
+		cerr << "Error: cannot create pipe: " << strerror(errno) << endl;
+		close(listener);
+		return 1;
+	}
+	fcntl(StopPipe[1], F_SETFL, O_NONBLOCK);
+
+	// Stop on SIGINT/SIGTERM, and do not die when a client disconnects
+	// early.
+	StopServer = 0;
+	struct sigaction action;
+	struct sigaction oldint;
+	struct sigaction oldterm;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = stopServerHandler;
+	sigemptyset(&action.sa_mask);
+	sigaction(SIGINT, &action, &oldint);
+	sigaction(SIGTERM, &action, &oldterm);
+	signal(SIGPIPE, SIG_IGN);
+
+	cerr << "hum2ly: serving on " << socketpath << " with "
+	     << m_converters.size() << " converters" << endl;
+
+	while (!StopServer) {
+		struct pollfd fds[2];
+		fds[0].fd = listener;
+		fds[0].events = POLLIN;
+		fds[0].revents = 0;
+		fds[1].fd = StopPipe[0];
+		fds[1].events = POLLIN;
+		fds[1].revents = 0;
+		if (poll(fds, 2, -1) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			cerr << "Error: poll failed: " << strerror(errno) << endl;
+			break;
+		}
+		if (fds[1].revents) {
+			break;
+		}
+		if (!fds[0].revents) {
+			continue;
+		}
+		int client = accept(listener, NULL, NULL);
+		if (client < 0) {
+			if ((errno == EINTR) || (errno == ECONNABORTED)) {
+				continue;
+			}
+			cerr << "Error: accept failed: " << strerror(errno) << endl;
+			break;
+		}
+		{
+			lock_guard<mutex> guard(m_clientlock);
+			m_clients.insert(client);
+		}
+		try {
+			thread(&ConversionServer::handleClient, this, client).detach();
+		} catch (exception& error) {
+			// Too many threads: drop the client but keep serving.
+			cerr << "Error: cannot start client thread: " << error.what()
+			     << endl;
+			lock_guard<mutex> guard(m_clientlock);
+			m_clients.erase(client);
+			close(client);
+		}
+	}
+
+	sigaction(SIGINT, &oldint, NULL);
+	sigaction(SIGTERM, &oldterm, NULL);
+	close(listener);
+	unlink(socketpath.c_str());
+
+	// Stop reading requests from the remaining clients (a conversion in
+	// progress is finished, but its response cannot be sent), and wait
+	// until all of the client threads are done with the server.
+	{
+		unique_lock<mutex> guard(m_clientlock);
+		for (int fd : m_clients) {
+			shutdown(fd, SHUT_RDWR);
+		}
+		while (!m_clients.empty()) {
+			m_clientsignal.wait(guard);
+		}
+	}
+
+	close(StopPipe[0]);
+	close(StopPipe[1]);
+	StopPipe[0] = StopPipe[1] = -1;
+
+	printLatency(cerr);
+	return 0;
+}
+
+
+
+//////////////////////////////
+//
+// ConversionServer::handleClient -- Answer requests from one client until
+//    it closes the connection (or the server shuts it down).  Exceptions
+//    (such as running out of memory for a large frame) close the
+//    connection instead of escaping from the thread, which would stop
+//    the server.  The client is removed from m_clients last, since run()
+//    may return (and the server be deleted) as soon as there are no
+//    clients left.
+//
+
+void ConversionServer::handleClient(int fd) {
+	string args;
+	string input;
+	string output;
+	string diagnostics;
+	try {
+		while (readFrame(fd, args) && readFrame(fd, input)) {
+			auto starttime = chrono::steady_clock::now();
+			bool status = convertRequest(args, input, output, diagnostics);
+			bool sent = writeFrame(fd, status ? "ok" : "error") &&
+					writeFrame(fd, output) && writeFrame(fd, diagnostics);
+			auto endtime = chrono::steady_clock::now();
+			recordLatency(chrono::duration<double, milli>(endtime -
+					starttime).count());
+			if (!sent) {
+				break;
+			}
+		}
+	} catch (exception& error) {
+		cerr << "Error: client connection closed: " << error.what() << endl;
+	}
+	{
+		lock_guard<mutex> guard(m_clientlock);
+		m_clients.erase(fd);
+		close(fd);
+		m_clientsignal.notify_all();
+	}
+}
+
+
+
+//////////////////////////////
+//
+// ConversionServer::convertRequest -- Convert the Humdrum data of a request
+//    with a converter from the pool.  Errors are returned separately from
+//    the lilypond data.  An exception during the conversion (such as from
+//    a -t worker thread, or running out of memory) fails only this
+//    request: the converter is returned to the pool and the exception's
+//    message is sent to the client as the diagnostics.
+//
+
+bool ConversionServer::convertRequest(const string& args, const string& input,
+		string& output, string& diagnostics) {
+	// Return the converter to the pool however the conversion ends.
+	class ConverterLease {
+		public:
+			ConverterLease(ConversionServer& server) : m_server(server) {
+				converter = m_server.acquireConverter();
+			}
+			~ConverterLease() {
+				converter->setErrorStream(NULL);
+				m_server.releaseConverter(converter);
+			}
+			HumdrumToLilypondConverter* converter;
+		private:
+			ConversionServer& m_server;
+	};
+
+	output.clear();
+	diagnostics.clear();
+	try {
+		shared_ptr<const ConversionConfig> config = getConfig(args);
+
+		HumdrumFile infile;
+		stringstream instream(input);
+		if (!HumdrumToLilypondConverter::readInput(infile, instream,
+				config->fullparse)) {
+			diagnostics = "Error: cannot parse input";
+			if (!infile.getParseError().empty()) {
+				diagnostics += ": " + infile.getParseError();
+			}
+			diagnostics += "\n";
+			return false;
+		}
+
+		stringstream out;
+		stringstream errout;
+		bool status;
+		{
+			ConverterLease lease(*this);
+			lease.converter->setConfig(config);
+			lease.converter->setErrorStream(&errout);
+			status = lease.converter->convert(out, infile);
+		}
+
+		output = out.str();
+		diagnostics = errout.str();
+		return status;
+	} catch (exception& error) {
+		output.clear();
+		diagnostics = string("Error: ") + error.what() + "\n";
+		return false;
+	}
+}
+
+
+
+//////////////////////////////
+//
+// ConversionServer::getConfig -- Return the settings for a request's
+//    options text (one command-line argument per line).  Clients usually
+//    send the same options with every request, so the options are only
+//    parsed the first time that they are seen.  Requests are always
+//    converted with one thread: the server already converts requests in
+//    parallel, and a -t option from a client would otherwise start that
+//    many threads for each converter in the pool.
+//
+
+shared_ptr<const ConversionConfig> ConversionServer::getConfig(
+		const string& args) {
+	{
+		lock_guard<mutex> lock(m_configlock);
+		auto entry = m_configs.find(args);
+		if (entry != m_configs.end()) {
+			return entry->second;
+		}
+	}
+
+	vector<string> arglist;
+	arglist.push_back("hum2ly");
+	stringstream argstream(args);
+	string arg;
+	while (getline(argstream, arg)) {
+		if (!arg.empty()) {
+			arglist.push_back(arg);
+		}
+	}
+	vector<char*> argv;
+	for (int i=0; i<(int)arglist.size(); i++) {
+		argv.push_back(&arglist[i][0]);
+	}
+	argv.push_back(NULL);
+	Options options = m_definitions;
+	// Do not exit the server on unknown options:
+	options.process((int)arglist.size(), argv.data(), 0);
+	ConversionConfig settings = *ConversionConfig::fromOptions(options);
+	settings.threads = 1;
+	shared_ptr<const ConversionConfig> config =
+			make_shared<const ConversionConfig>(settings);
+
+	lock_guard<mutex> lock(m_configlock);
+	if (m_configs.size() >= 1000) {
+		// limit the memory used by clients sending many different options
+		m_configs.clear();
+	}
+	m_configs[args] = config;
+	return config;
+}
+
+
+
+//////////////////////////////
+//
+// ConversionServer::acquireConverter -- Wait for an idle converter.
+//
+
+HumdrumToLilypondConverter* ConversionServer::acquireConverter(void) {
+	unique_lock<mutex> guard(m_idlelock);
+	while (m_idle.empty()) {
+		m_idlesignal.wait(guard);
+	}
+	HumdrumToLilypondConverter* converter = m_idle.back();
+	m_idle.pop_back();
+	return converter;
+}
+
+
+
+//////////////////////////////
+//
+// ConversionServer::releaseConverter -- Return a converter to the pool.
+//
+
+void ConversionServer::releaseConverter(HumdrumToLilypondConverter* converter) {
+	{
+		lock_guard<mutex> guard(m_idlelock);
+		m_idle.push_back(converter);
+	}
+	m_idlesignal.notify_one();
+}
+
+
+
+//////////////////////////////
+//
+// ConversionServer::recordLatency -- Store the time taken to answer a
+//    request.  Only the last MaxLatencies times are kept (m_latencies is
+//    a ring buffer), so a long-running server uses a fixed amount of
+//    memory.  A summary is printed every 1000 requests.
+//
+
+void ConversionServer::recordLatency(double milliseconds) {
+	bool report;
+	{
+		lock_guard<mutex> guard(m_latencylock);
+		if ((int)m_latencies.size() < MaxLatencies) {
+			m_latencies.push_back(milliseconds);
+		} else {
+			m_latencies[m_requests % MaxLatencies] = milliseconds;
+		}
+		m_requests++;
+		report = (m_requests % 1000) == 0;
+	}
+	if (report) {
+		printLatency(cerr);
+	}
+}
+
+
+
+//////////////////////////////
+//
+// ConversionServer::printLatency -- Print the request count and the
+//    median (p50) and 99th percentile (p99) latencies of the most recent
+//    requests.
+//
+
+void ConversionServer::printLatency(ostream& out) {
+	vector<double> sorted;
+	long requests;
+	{
+		lock_guard<mutex> guard(m_latencylock);
+		sorted = m_latencies;
+		requests = m_requests;
+	}
+	sort(sorted.begin(), sorted.end());
+	out << "hum2ly: " << requests << " requests, p50 "
+	    << getPercentile(sorted, 0.50) << " ms, p99 "
+	    << getPercentile(sorted, 0.99) << " ms";
+	if ((long)sorted.size() < requests) {
+		out << " (last " << sorted.size() << " requests)";
+	}
+	out << endl;
+}
+
+
+
+//////////////////////////////
+//
+// runConversionClient -- Send each file (or standard input if there are
+//    no files) to a conversion server.  The lilypond data is printed to
+//    standard output and the diagnostics to standard error.  If more than
+//    one request is sent, the latency is summarized on standard error.
+//    Returns 1 if any conversion failed.
+//
+
+int runConversionClient(const string& socketpath, const vector<string>& args,
+		const vector<string>& files) {
+	struct sockaddr_un address;
+	if (!getSocketAddress(socketpath, address)) {
+		cerr << "Error: socket path too long: " << socketpath << endl;
+		return 1;
+	}
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if ((fd < 0) || (connect(fd, (struct sockaddr*)&address,
+			sizeof(address)) < 0)) {
+		cerr << "Error: cannot connect to " << socketpath << ": "
+		     << strerror(errno) << endl;
+		if (fd >= 0) {
+			close(fd);
+		}
+		return 1;
+	}
+
+	string argframe;
+	for (int i=0; i<(int)args.size(); i++) {
+		argframe += args[i];
+		argframe += '\n';
+	}
+
+	vector<string> inputs = files;
+	if (inputs.empty()) {
+		inputs.push_back("");
+	}
+
+	int failures = 0;
+	vector<double> latencies;
+	string input;
+	string status;
+	string output;
+	string diagnostics;
+	for (int i=0; i<(int)inputs.size(); i++) {
+		stringstream buffer;
+		if (inputs[i].empty()) {
+			buffer << cin.rdbuf();
+		} else {
+			ifstream infile(inputs[i].c_str());
+			if (!infile.is_open()) {
+				cerr << "Error: cannot read " << inputs[i] << endl;
+				failures++;
+				continue;
+			}
+			buffer << infile.rdbuf();
+		}
+		input = buffer.str();
+
+		auto starttime = chrono::steady_clock::now();
+		if (!(writeFrame(fd, argframe) && writeFrame(fd, input) &&
+				readFrame(fd, status) && readFrame(fd, output) &&
+				readFrame(fd, diagnostics))) {
+			cerr << "Error: lost connection to " << socketpath << endl;
+			close(fd);
+			return 1;
+		}
+		auto endtime = chrono::steady_clock::now();
+		latencies.push_back(chrono::duration<double, milli>(endtime -
+				starttime).count());
+
+		cout << output;
+		cerr << diagnostics;
+		if (status != "ok") {
+			cerr << "Error converting file: "
+			     << (inputs[i].empty() ? "<STDIN>" : inputs[i]) << endl;
+			failures++;
+		}
+	}
+	close(fd);
+	cout.flush();
+
+	if (latencies.size() > 1) {
+		sort(latencies.begin(), latencies.end());
+		cerr << "hum2ly: " << latencies.size() << " requests, p50 "
+		     << getPercentile(latencies, 0.50) << " ms, p99 "
+		     << getPercentile(latencies, 0.99) << " ms" << endl;
+	}
+
+	return failures ? 1 : 0;
+}
+
+
+
+//////////////////////////////
+//
+// stopServerHandler -- Signal handler for SIGINT and SIGTERM.  Only
+//    async-signal-safe functions may be used here.
+//
+
+static void stopServerHandler(int signum) {
+	int saved = errno;
+	StopServer = 1;
+	if (StopPipe[1] >= 0) {
+		ssize_t status = write(StopPipe[1], "x", 1);
+		(void)status;
+	}
+	errno = saved;
+}
+
+
+
+//////////////////////////////
+//
+// getPercentile -- Nearest-rank percentile of sorted values.
+//
+
+static double getPercentile(const vector<double>& sorted, double fraction) {
+	if (sorted.empty()) {
+		return 0.0;
+	}
+	int index = (int)(fraction * sorted.size() + 0.999999) - 1;
+	index = max(0, min(index, (int)sorted.size() - 1));
+	return sorted[index];
+}
+
+
+
+//////////////////////////////
+//
+// getSocketAddress -- Fill in a Unix domain socket address.  Returns false if the
+//    path is too long.
+//
+
+static bool getSocketAddress(const string& socketpath, struct sockaddr_un& address) {
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (socketpath.size() >= sizeof(address.sun_path)) {
+		return false;
+	}
+	strncpy(address.sun_path, socketpath.c_str(), sizeof(address.sun_path) - 1);
+	return true;
+}
+
+
+
+}  // end of namespace hum
+
+
+
@@ -0,0 +1,94 @@
+//
+// Programmer:    Craig Stuart Sapp <craig@ccrma.stanford.edu>
+// Creation Date: Fri Oct 16 14:02:37 CEST 2026
+// Last Modified: Fri Oct 16 14:02:37 CEST 2026
+// Filename:      server.h
+// URL:           https://github.com/craigsapp/hum2ly/blob/master/server.h
+// Syntax:        C++11
+// vim:           ts=3 noexpandtab
+//
+// Description:   Conversion server which keeps warm converters and answers
+//                requests over a Unix domain socket, and a matching client.
+//
+// Protocol:      Every message is a sequence of frames.  A frame is a
+//                4-byte big-endian length followed by that many bytes.
+//                A request is two frames: the conversion options (one
+//                command-line argument per line) and the Humdrum data.
+//                A response is three frames: "ok" or "error", the
+//                lilypond data, and the diagnostic messages.  A client
+//                may send any number of requests on one connection.
+//
+
+#ifndef _SERVER_H
+#define _SERVER_H
+
+#include "hum2ly.h"
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace hum {
+
+using namespace std;
+
+bool readFrame  (int fd, string& data);
+bool writeFrame (int fd, const string& data);
+
+
+//////////////////////////////
+//
+// ConversionServer -- Accept conversion requests on a Unix domain socket.
+//    Each client connection is handled in its own thread, and conversions
+//    are done with a fixed pool of converters which are reused between
+//    requests.
+//
+
+class ConversionServer {
+	public:
+		ConversionServer(const Options& definitions, int poolsize = 0);
+		~ConversionServer() {}
+
+		int     run                (const string& socketpath);
+		void    printLatency       (ostream& out);
+
+	protected:
+		void    handleClient       (int fd);
+		bool    convertRequest     (const string& args, const string& input,
+		                            string& output, string& diagnostics);
+		shared_ptr<const ConversionConfig> getConfig(const string& args);
+		HumdrumToLilypondConverter* acquireConverter(void);
+		void    releaseConverter   (HumdrumToLilypondConverter* converter);
+		void    recordLatency      (double milliseconds);
+
+	private:
+		Options  m_definitions;  // option definitions for requests
+		unordered_map<string, shared_ptr<const ConversionConfig>> m_configs;
+		mutex    m_configlock;   // configs for each request options text
+		vector<unique_ptr<HumdrumToLilypondConverter>> m_converters;
+		vector<HumdrumToLilypondConverter*> m_idle; // converters not in use
+		mutex    m_idlelock;
+		condition_variable m_idlesignal;
+		vector<double> m_latencies;  // milliseconds of recent requests
+		long     m_requests;     // number of requests answered
+		mutex    m_latencylock;
+		unordered_set<int> m_clients; // sockets of active client threads
+		mutex    m_clientlock;
+		condition_variable m_clientsignal; // a client thread has finished
+};
+
+
+int runConversionClient(const string& socketpath, const vector<string>& args,
+		const vector<string>& files);
+
+
+}  // end of namespace hum
+
+
+#endif /* _SERVER_H */
+
+
+
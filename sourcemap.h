@@ -0,0 +1,39 @@
+//
+// Programmer:    Craig Stuart Sapp <craig@ccrma.stanford.edu>
+// Creation Date: Sat Oct 17 14:48:20 CEST 2026
+// Last Modified: Sat Oct 17 14:48:20 CEST 2026
+// Filename:      sourcemap.h
+// URL:           https://github.com/craigsapp/hum2ly/blob/master/sourcemap.h
+// Syntax:        C++11
+// vim:           ts=3 noexpandtab
+//
+// Description:   Link between a position in the lilypond output and the
+//                Humdrum token which was converted there.
+//
+
+#ifndef _SOURCEMAP_H
+#define _SOURCEMAP_H
+
+namespace hum {
+
+
+//////////////////////////////
+//
+// SourceMapEntry -- The output offset of a converted token.
+//
+
+class SourceMapEntry {
+	public:
+		long offset;  // byte offset in the lilypond output
+		int  line;    // Humdrum line number (starting at 1)
+		int  field;   // Humdrum field number (starting at 1)
+};
+
+
+}  // end of namespace hum
+
+
+#endif /* _SOURCEMAP_H */
+
+
+
@@ -0,0 +1,78 @@
+//
+// Programmer:    Craig Stuart Sapp <craig@ccrma.stanford.edu>
+// Creation Date: Sat Oct 17 15:02:18 CEST 2026
+// Last Modified: Sat Oct 17 15:02:18 CEST 2026
+// Filename:      spinecursor.h
+// URL:           https://github.com/craigsapp/hum2ly/blob/master/spinecursor.h
+// Syntax:        C++11
+// vim:           ts=3 noexpandtab
+//
+// Description:   Iterate over the tokens of a spine within a range of lines.
+//
+
+#ifndef _SPINECURSOR_H
+#define _SPINECURSOR_H
+
+#include "humlib.h"
+
+namespace hum {
+
+using namespace std;
+
+
+//////////////////////////////
+//
+// SpineCursor -- Follow a spine from a starting token (through the first
+//    next token at spine splits) until the line before endline or the end
+//    of the spine.  Exclusive interpretations are skipped unless they are
+//    the last token of the spine.  The cursor is a loop variable, so
+//    traversals use constant stack space for any length of spine:
+//
+//       for (SpineCursor cursor(start, endline); !cursor.atEnd();
+//             cursor.next()) {
+//          HTp token = cursor.getToken();
+//       }
+//
+
+class SpineCursor {
+	public:
+		SpineCursor(HTp start, int endline) : m_token(start),
+				m_endline(endline) {
+			skip();
+		}
+
+		bool atEnd(void) const {
+			return (m_token == NULL) || (m_token->getLineIndex() >= m_endline);
+		}
+
+		HTp  getToken(void) const { return m_token; }
+
+		void next(void) {
+			m_token = m_token->getNextToken();
+			skip();
+		}
+
+		static bool isSkipped(HTp token) {
+			return token->isExclusive() && (token->getNextToken() != NULL);
+		}
+
+	protected:
+		void skip(void) {
+			while ((m_token != NULL) && isSkipped(m_token)) {
+				m_token = m_token->getNextToken();
+			}
+		}
+
+	private:
+		HTp m_token;    // current token (NULL at the end of the spine)
+		int m_endline;  // line index after the last line of the range
+};
+
+
+}  // end of namespace hum
+
+
+#endif /* _SPINECURSOR_H */
+
+
+
@@ -0,0 +1,150 @@
+//
+// Programmer:    Craig Stuart Sapp <craig@ccrma.stanford.edu>
+// Creation Date: Fri Oct 16 21:02:18 CEST 2026
+// Last Modified: Fri Oct 16 21:02:18 CEST 2026
+// Filename:      statistics.cpp
+// URL:           https://github.com/craigsapp/hum2ly/blob/master/statistics.cpp
+// Syntax:        C++11
+// vim:           ts=3 noexpandtab
+//
+// Description:   Counters describing the contents of converted files,
+//                for capacity planning and for finding unsupported
+//                constructs in a corpus.
+//
+
+#include "statistics.h"
+
+#include <cstdlib>
+
+using namespace std;
+
+namespace hum {
+
+
+//////////////////////////////
+//
+// ConversionStatistics::clear --
+//
+
+void ConversionStatistics::clear(void) {
+	files            = 0;
+	lines            = 0;
+	parts            = 0;
+	segments         = 0;
+	notes            = 0;
+	rests            = 0;
+	nulls            = 0;
+	interpretations  = 0;
+	barlines         = 0;
+	chords           = 0;
+	droppeddurations = 0;
+	unknownclefs     = 0;
+	unknownkeys      = 0;
+	outputbytes      = 0;
+	errors           = 0;
+}
+
+
+
+//////////////////////////////
+//
+// ConversionStatistics::add -- Add the counts of another file (or of
+//    another set of files).
+//
+
+void ConversionStatistics::add(const ConversionStatistics& other) {
+	files            += other.files;
+	lines            += other.lines;
+	parts            += other.parts;
+	segments         += other.segments;
+	notes            += other.notes;
+	rests            += other.rests;
+	nulls            += other.nulls;
+	interpretations  += other.interpretations;
+	barlines         += other.barlines;
+	chords           += other.chords;
+	droppeddurations += other.droppeddurations;
+	unknownclefs     += other.unknownclefs;
+	unknownkeys      += other.unknownkeys;
+	outputbytes      += other.outputbytes;
+	errors           += other.errors;
+}
+
+
+
+//////////////////////////////
+//
+// ConversionStatistics::writeJson --
+//
+
+void ConversionStatistics::writeJson(ostream& out) const {
+	out << "{\n";
+	out << "\t\"files\": "             << files            << ",\n";
+	out << "\t\"lines\": "             << lines            << ",\n";
+	out << "\t\"parts\": "             << parts            << ",\n";
+	out << "\t\"segments\": "          << segments         << ",\n";
+	out << "\t\"notes\": "             << notes            << ",\n";
+	out << "\t\"rests\": "             << rests            << ",\n";
+	out << "\t\"nulls\": "             << nulls            << ",\n";
+	out << "\t\"interpretations\": "   << interpretations  << ",\n";
+	out << "\t\"barlines\": "          << barlines         << ",\n";
+	out << "\t\"chords\": "            << chords           << ",\n";
+	out << "\t\"dropped_durations\": " << droppeddurations << ",\n";
+	out << "\t\"unknown_clefs\": "     << unknownclefs     << ",\n";
+	out << "\t\"unknown_keys\": "      << unknownkeys      << ",\n";
+	out << "\t\"output_bytes\": "      << outputbytes      << ",\n";
+	out << "\t\"errors\": "            << errors           << "\n";
+	out << "}\n";
+}
+
+
+
+//////////////////////////////
+//
+// ConversionStatistics::readJson -- Read the counts written by
+//    writeJson().  Returns false (and leaves the counts cleared) if any
+//    of the counts is missing.
+//
+
+bool ConversionStatistics::readJson(const string& text) {
+	static const struct {
+		const char* name;
+		long ConversionStatistics::* count;
+	} fields[] = {
+		{ "files",             &ConversionStatistics::files            },
+		{ "lines",             &ConversionStatistics::lines            },
+		{ "parts",             &ConversionStatistics::parts            },
+		{ "segments",          &ConversionStatistics::segments         },
+		{ "notes",             &ConversionStatistics::notes            },
+		{ "rests",             &ConversionStatistics::rests            },
+		{ "nulls",             &ConversionStatistics::nulls            },
+		{ "interpretations",   &ConversionStatistics::interpretations  },
+		{ "barlines",          &ConversionStatistics::barlines         },
+		{ "chords",            &ConversionStatistics::chords           },
+		{ "dropped_durations", &ConversionStatistics::droppeddurations },
+		{ "unknown_clefs",     &ConversionStatistics::unknownclefs     },
+		{ "unknown_keys",      &ConversionStatistics::unknownkeys      },
+		{ "output_bytes",      &ConversionStatistics::outputbytes      },
+		{ "errors",            &ConversionStatistics::errors           }
+	};
+
+	clear();
+	for (const auto& field : fields) {
+		string name = string("\"") + field.name + "\":";
+		size_t position = text.find(name);
+		if (position == string::npos) {
+			clear();
+			return false;
+		}
+		this->*field.count = strtol(text.c_str() + position + name.size(),
+				NULL, 10);
+	}
+	return true;
+}
+
+
+
+}  // end of namespace hum
+
+
+
@@ -0,0 +1,65 @@
+//
+// Programmer:    Craig Stuart Sapp <craig@ccrma.stanford.edu>
+// Creation Date: Fri Oct 16 21:02:18 CEST 2026
+// Last Modified: Fri Oct 16 21:02:18 CEST 2026
+// Filename:      statistics.h
+// URL:           https://github.com/craigsapp/hum2ly/blob/master/statistics.h
+// Syntax:        C++11
+// vim:           ts=3 noexpandtab
+//
+// Description:   Counters describing the contents of converted files,
+//                for capacity planning and for finding unsupported
+//                constructs in a corpus.
+//
+
+#ifndef _STATISTICS_H
+#define _STATISTICS_H
+
+#include <ostream>
+#include <string>
+
+namespace hum {
+
+using namespace std;
+
+
+//////////////////////////////
+//
+// ConversionStatistics -- Counts for one file, or totals for many files.
+//
+
+class ConversionStatistics {
+	public:
+		ConversionStatistics(void) { clear(); }
+		~ConversionStatistics() {}
+
+		void clear     (void);
+		void add       (const ConversionStatistics& other);
+		void writeJson (ostream& out) const;
+		bool readJson  (const string& text);
+
+		long files;            // number of files converted
+		long lines;            // Humdrum lines
+		long parts;            // **kern spines
+		long segments;         // labeled sections (1 if no labels)
+		long notes;            // note tokens
+		long rests;            // rest tokens
+		long nulls;            // null data tokens
+		long interpretations;  // non-null interpretation tokens
+		long barlines;         // barline tokens
+		long chords;           // chords (not yet supported)
+		long droppeddurations; // rhythms without a lilypond duration
+		long unknownclefs;     // clefs without a lilypond equivalent
+		long unknownkeys;      // non-standard or unknown key signatures
+		long outputbytes;      // size of the lilypond output
+		long errors;           // error messages (each counted once)
+};
+
+
+}  // end of namespace hum
+
+
+#endif /* _STATISTICS_H */
+
+
+
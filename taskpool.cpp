@@ -0,0 +1,327 @@
+//
+// Programmer:    Craig Stuart Sapp <craig@ccrma.stanford.edu>
+// Creation Date: Fri Oct 16 09:12:08 CEST 2026
+// Last Modified: Fri Oct 16 09:12:08 CEST 2026
+// Filename:      taskpool.cpp
+// URL:           https://github.com/craigsapp/hum2ly/blob/master/taskpool.cpp
+// Syntax:        C++11
+// vim:           ts=3 noexpandtab
+//
+// Description:   Work-stealing thread pool for running independent
+//                conversion tasks in parallel.
+//
+
+#include "taskpool.h"
+
+using namespace std;
+
+namespace hum {
+
+
+//////////////////////////////
+//
+// TaskPool::TaskPool -- Constructor.  A thread count of 0 means to use
+//    one worker for each hardware thread.
+//
+
+TaskPool::TaskPool(int threadcount) {
+	m_work       = NULL;
+	m_cancel     = false;
+	m_generation = 0;
+	m_active     = 0;
+	m_busy       = 0;
+	m_stop       = false;
+	m_threadcount = 0;
+	setThreadCount(threadcount);
+}
+
+
+
+//////////////////////////////
+//
+// TaskPool::setThreadCount -- Running threads are stopped if the count
+//    changes (and the new number of threads is started by the next run).
+//
+
+void TaskPool::setThreadCount(int threadcount) {
+	if (threadcount <= 0) {
+		threadcount = getHardwareThreadCount();
+	}
+	if (threadcount == m_threadcount) {
+		return;
+	}
+	stopThreads();
+	m_threadcount = threadcount;
+}
+
+
+
+//////////////////////////////
+//
+// TaskPool::startThreads -- Start the worker threads if they are not
+//    running yet.
+//
+
+void TaskPool::startThreads(void) {
+	if (!m_threads.empty()) {
+		return;
+	}
+	{
+		lock_guard<mutex> guard(m_runlock);
+		m_stop = false;
+	}
+	m_threads.reserve(m_threadcount);
+	for (int i=0; i<m_threadcount; i++) {
+		m_threads.emplace_back(&TaskPool::threadMain, this, i);
+	}
+}
+
+
+
+//////////////////////////////
+//
+// TaskPool::stopThreads -- Tell the worker threads to exit and wait for
+//    them.
+//
+
+void TaskPool::stopThreads(void) {
+	if (m_threads.empty()) {
+		return;
+	}
+	{
+		lock_guard<mutex> guard(m_runlock);
+		m_stop = true;
+	}
+	m_runsignal.notify_all();
+	for (int i=0; i<(int)m_threads.size(); i++) {
+		m_threads[i].join();
+	}
+	m_threads.clear();
+}
+
+
+
+//////////////////////////////
+//
+// TaskPool::threadMain -- Wait for a run to start, process its tasks if
+//    this worker is used by the run, and wait for the next run.
+//
+
+void TaskPool::threadMain(int worker) {
+	int generation = 0;
+	while (true) {
+		{
+			unique_lock<mutex> guard(m_runlock);
+			while (!m_stop && (m_generation == generation)) {
+				m_runsignal.wait(guard);
+			}
+			if (m_stop) {
+				return;
+			}
+			generation = m_generation;
+			if (worker >= m_active) {
+				continue;
+			}
+		}
+		workerLoop(worker);
+		{
+			lock_guard<mutex> guard(m_runlock);
+			m_busy--;
+			if (m_busy == 0) {
+				m_idlesignal.notify_all();
+			}
+		}
+	}
+}
+
+
+
+//////////////////////////////
+//
+// TaskPool::getHardwareThreadCount -- Returns at least 1.
+//
+
+int TaskPool::getHardwareThreadCount(void) {
+	int count = (int)thread::hardware_concurrency();
+	if (count < 1) {
+		count = 1;
+	}
+	return count;
+}
+
+
+
+//////////////////////////////
+//
+// TaskPool::run -- Run tasks 0 to taskcount-1, and return when all of them
+//    have finished.  The optional done function is called from the calling
+//    thread for each task in task order as soon as that task and all
+//    earlier tasks have finished, which allows results to be written out
+//    in order while later tasks are still running.
+//
+//    If a task (or the done function) throws an exception, the tasks which
+//    have not started are skipped, no more done functions are called, and
+//    the first exception is thrown again from run() after all of the
+//    workers have finished.
+//
+
+void TaskPool::run(int taskcount, const TaskFunction& work) {
+	run(taskcount, work, DoneFunction());
+}
+
+
+void TaskPool::run(int taskcount, const TaskFunction& work,
+		const DoneFunction& done) {
+	if (taskcount <= 0) {
+		return;
+	}
+
+	int workers = m_threadcount;
+	if (workers > taskcount) {
+		workers = taskcount;
+	}
+
+	if (workers <= 1) {
+		// No need for threads, so run everything in the calling thread.
+		for (int i=0; i<taskcount; i++) {
+			work(i, 0);
+			if (done) {
+				done(i);
+			}
+		}
+		return;
+	}
+
+	vector<WorkQueue> queues(workers);
+	m_queues.swap(queues);
+	m_done.assign(taskcount, 0);
+	m_work = &work;
+	m_exception = nullptr;
+	m_cancel = false;
+
+	// Deal out tasks round-robin so that the earliest tasks are started
+	// first (which is best for the ordered done callbacks).
+	for (int i=0; i<taskcount; i++) {
+		m_queues[i % workers].tasks.push_back(i);
+	}
+
+	startThreads();
+	{
+		lock_guard<mutex> guard(m_runlock);
+		m_active = workers;
+		m_busy   = workers;
+		m_generation++;
+	}
+	m_runsignal.notify_all();
+
+	if (done) {
+		for (int i=0; i<taskcount; i++) {
+			unique_lock<mutex> guard(m_donelock);
+			while (!m_done[i]) {
+				m_donesignal.wait(guard);
+			}
+			if (m_exception) {
+				break;
+			}
+			guard.unlock();
+			try {
+				done(i);
+			} catch (...) {
+				lock_guard<mutex> errorguard(m_donelock);
+				m_exception = current_exception();
+				m_cancel = true;
+				break;
+			}
+		}
+	}
+
+	{
+		unique_lock<mutex> guard(m_runlock);
+		while (m_busy > 0) {
+			m_idlesignal.wait(guard);
+		}
+	}
+
+	m_work = NULL;
+	vector<WorkQueue> empty;
+	m_queues.swap(empty);
+
+	if (m_exception) {
+		exception_ptr error = m_exception;
+		m_exception = nullptr;
+		rethrow_exception(error);
+	}
+}
+
+
+
+//////////////////////////////
+//
+// TaskPool::workerLoop -- Process tasks until there are none left in
+//    any queue.  Exceptions are kept for run() (an exception which leaves
+//    a thread function would terminate the program).
+//
+
+void TaskPool::workerLoop(int worker) {
+	int task;
+	while (getTask(worker, task)) {
+		exception_ptr error;
+		if (!m_cancel) {
+			try {
+				(*m_work)(task, worker);
+			} catch (...) {
+				error = current_exception();
+			}
+		}
+		{
+			lock_guard<mutex> guard(m_donelock);
+			if (error && !m_exception) {
+				m_exception = error;
+				m_cancel = true;
+			}
+			m_done[task] = 1;
+		}
+		m_donesignal.notify_all();
+	}
+}
+
+
+
+//////////////////////////////
+//
+// TaskPool::getTask -- Take the next task from the front of the worker's
+//    own queue, or steal one from the back of another worker's queue.
+//    Returns false when all queues are empty.
+//
+
+bool TaskPool::getTask(int worker, int& task) {
+	{
+		WorkQueue& queue = m_queues[worker];
+		lock_guard<mutex> guard(queue.lock);
+		if (!queue.tasks.empty()) {
+			task = queue.tasks.front();
+			queue.tasks.pop_front();
+			return true;
+		}
+	}
+
+	int count = (int)m_queues.size();
+	for (int i=1; i<count; i++) {
+		WorkQueue& victim = m_queues[(worker + i) % count];
+		lock_guard<mutex> guard(victim.lock);
+		if (!victim.tasks.empty()) {
+			task = victim.tasks.back();
+			victim.tasks.pop_back();
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+
+}  // end of namespace hum
+
+
+
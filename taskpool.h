@@ -0,0 +1,101 @@
+//
+// Programmer:    Craig Stuart Sapp <craig@ccrma.stanford.edu>
+// Creation Date: Fri Oct 16 09:12:08 CEST 2026
+// Last Modified: Fri Oct 16 09:12:08 CEST 2026
+// Filename:      taskpool.h
+// URL:           https://github.com/craigsapp/hum2ly/blob/master/taskpool.h
+// Syntax:        C++11
+// vim:           ts=3 noexpandtab
+//
+// Description:   Work-stealing thread pool for running independent
+//                conversion tasks in parallel.
+//
+
+#ifndef _TASKPOOL_H
+#define _TASKPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace hum {
+
+using namespace std;
+
+
+//////////////////////////////
+//
+// TaskPool -- Run a numbered list of tasks on a set of worker threads.
+//    Each worker owns a queue of task indexes which it processes from
+//    the front.  When a worker runs out of tasks, it steals from the back
+//    of another worker's queue, so a few long tasks do not hold up the
+//    rest of the work.  The worker threads are started by the first run()
+//    and wait for the next run() until the pool is destroyed, so a pool
+//    which is kept (such as by a converter) does not start new threads for
+//    each run.
+//
+
+class TaskPool {
+	public:
+		typedef function<void(int task, int worker)> TaskFunction;
+		typedef function<void(int task)>             DoneFunction;
+
+		TaskPool(int threadcount = 0);
+		~TaskPool() { stopThreads(); }
+
+		int   getThreadCount (void) const { return m_threadcount; }
+		void  setThreadCount (int threadcount);
+		void  run            (int taskcount, const TaskFunction& work);
+		void  run            (int taskcount, const TaskFunction& work,
+		                      const DoneFunction& done);
+
+		static int getHardwareThreadCount(void);
+
+	protected:
+		void  startThreads   (void);
+		void  stopThreads    (void);
+		void  threadMain     (int worker);
+		void  workerLoop     (int worker);
+		bool  getTask        (int worker, int& task);
+
+	private:
+		// Not copyable since it owns threads:
+		TaskPool(const TaskPool&);
+		TaskPool& operator=(const TaskPool&);
+
+		struct WorkQueue {
+			mutex       lock;
+			deque<int>  tasks;
+		};
+
+		int                m_threadcount;  // number of worker threads
+		vector<WorkQueue>  m_queues;       // task queue for each worker
+		const TaskFunction* m_work;        // task function for current run
+		vector<char>       m_done;         // completion flag for each task
+		mutex              m_donelock;     // lock for m_done
+		condition_variable m_donesignal;   // signaled when a task finishes
+		exception_ptr      m_exception;    // first exception of current run
+		atomic<bool>       m_cancel;       // skip the remaining tasks
+		vector<thread>     m_threads;      // worker threads (kept between runs)
+		mutex              m_runlock;      // lock for the variables below
+		condition_variable m_runsignal;    // signaled when a run starts
+		condition_variable m_idlesignal;   // signaled when workers finish
+		int                m_generation;   // number of runs started
+		int                m_active;       // workers used in current run
+		int                m_busy;         // workers still running
+		bool               m_stop;         // true when threads should exit
+};
+
+
+}  // end of namespace hum
+
+
+#endif /* _TASKPOOL_H */
+
+
+
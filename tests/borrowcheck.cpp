@@ -0,0 +1,89 @@
+//
+// Programmer:    Craig Stuart Sapp <craig@ccrma.stanford.edu>
+// Creation Date: Sun Oct 18 10:05:31 CEST 2026
+// Last Modified: Sun Oct 18 10:05:31 CEST 2026
+// Filename:      tests/borrowcheck.cpp
+// URL:           https://github.com/craigsapp/hum2ly/blob/master/tests/borrowcheck.cpp
+// Syntax:        C++11
+// vim:           ts=3 noexpandtab
+//
+// Description:   Check that converting a HumdrumFile (which the converter
+//                borrows from the caller) does not change it.  The text,
+//                tracks and token links of each file are recorded before
+//                and after conversions with the serial, parallel and
+//                line-major engines.  Exits with 1 if anything changed.
+//
+
+#include "hum2ly.h"
+
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+using namespace hum;
+
+// function declarations:
+string getSnapshot(HumdrumFile& infile);
+
+
+int main(int argc, char** argv) {
+	vector<vector<string>> settings = {
+		{ "hum2ly" },
+		{ "hum2ly", "-t", "4" },
+		{ "hum2ly", "--line-major" },
+		{ "hum2ly", "-k" }
+	};
+
+	int status = 0;
+	for (int i=1; i<argc; i++) {
+		HumdrumFile infile;
+		if (!HumdrumToLilypondConverter::readInput(infile, string(argv[i]))) {
+			cerr << "Error: cannot read " << argv[i] << endl;
+			return 1;
+		}
+		string before = getSnapshot(infile);
+		for (int j=0; j<(int)settings.size(); j++) {
+			HumdrumToLilypondConverter converter;
+			converter.setOptions(settings[j]);
+			stringstream out;
+			converter.convert(out, infile);
+			if (getSnapshot(infile) != before) {
+				cerr << "Error: " << argv[i] << " was changed by converting with";
+				for (int k=1; k<(int)settings[j].size(); k++) {
+					cerr << " " << settings[j][k];
+				}
+				cerr << endl;
+				status = 1;
+				break;
+			}
+		}
+	}
+
+	return status;
+}
+
+
+
+//////////////////////////////
+//
+// getSnapshot -- The text of each line, and the track and next token of
+//    each token.
+//
+
+string getSnapshot(HumdrumFile& infile) {
+	stringstream output;
+	for (int i=0; i<infile.getLineCount(); i++) {
+		output << (string)infile[i] << "\n";
+		for (int j=0; j<infile[i].getFieldCount(); j++) {
+			HTp token = infile[i].token(j);
+			HTp next = token->getNextToken();
+			output << "\t" << token->getTrack() << ":"
+			       << (next ? next->getLineIndex() : -1);
+		}
+		output << "\n";
+	}
+	return output.str();
+}
+
+
+